@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_MIN_BLOCK (64 * 1024)
+
+struct BG3DArenaBlock {
+	struct BG3DArenaBlock * next;
+	size_t size;
+	size_t used;
+	_Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+void initArena (BG3DArena * arena) {
+	memset(arena, 0, sizeof(BG3DArena));
+}
+
+// Returns size bytes aligned for SIMD loads. Blocks are only ever added,
+// so nothing allocated here moves or is freed until the arena is reset.
+void * arenaAlloc (BG3DArena * arena, size_t size) {
+	size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+	BG3DArenaBlock * block = arena->current;
+
+	// after a reset the blocks are reused in order before new ones are made
+	while (block != NULL && block->size - block->used < size) {
+		block = block->next;
+
+		if (block != NULL) {
+			block->used = 0;
+		}
+	}
+
+	if (block == NULL) {
+		size_t blockSize = arena->current ? arena->current->size * 2 : ARENA_MIN_BLOCK;
+
+		if (blockSize < size) {
+			blockSize = size;
+		}
+
+		block = malloc(sizeof(BG3DArenaBlock) + blockSize);
+
+		if (block == NULL) {
+			return NULL;
+		}
+
+		block->size = blockSize;
+		block->used = 0;
+
+		// new blocks go after the current one so the chain stays in use order
+		if (arena->current != NULL) {
+			block->next = arena->current->next;
+			arena->current->next = block;
+		} else {
+			block->next = arena->first;
+			arena->first = block;
+		}
+	}
+
+	arena->current = block;
+	arena->last = block->data + block->used;
+	block->used += size;
+
+	return arena->last;
+}
+
+// Resizes an allocation. The most recent allocation grows in place when its
+// block has room; anything else is copied and the old space is abandoned.
+void * arenaGrow (BG3DArena * arena, void * old, size_t oldSize, size_t newSize) {
+	if (old != NULL && old == arena->last) {
+		BG3DArenaBlock * block = arena->current;
+		size_t offset = (unsigned char *) old - block->data;
+		size_t size = (newSize + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+		if (offset + size <= block->size) {
+			block->used = offset + size;
+			return old;
+		}
+	}
+
+	void * grown = arenaAlloc(arena, newSize);
+
+	if (grown != NULL && old != NULL) {
+		memcpy(grown, old, oldSize);
+	}
+
+	return grown;
+}
+
+// Makes all the arena's memory available again without returning it.
+void resetArena (BG3DArena * arena) {
+	arena->current = arena->first;
+	arena->last = NULL;
+
+	if (arena->first != NULL) {
+		arena->first->used = 0;
+	}
+}
+
+void freeArena (BG3DArena * arena) {
+	BG3DArenaBlock * block = arena->first;
+
+	while (block != NULL) {
+		BG3DArenaBlock * next = block->next;
+		free(block);
+		block = next;
+	}
+
+	initArena(arena);
+}
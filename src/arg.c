@@ -1,24 +1,42 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
-#include "common.c"
+#include "arg.h"
 
-uint8_t argState;
-char * inputPath;
+uint16_t argState;
+char ** inputPaths;
+int numInputs;
 char * outputName;
+int textureLevel = 6;
+int blockFit;
+
+void die() {
+  printf("Something went wrong.\n");
+  exit(1);
+}
 
 void setArgState(int argc, char *argv[]) {
-	extern char * inputPath;
+	extern char ** inputPaths;
+	extern int numInputs;
 	extern char * outputName;
-	extern uint8_t argState;
+	extern uint16_t argState;
+	extern int textureLevel;
+	extern int blockFit;
+
+	// the paths are gathered in place, argv never needs them again
+	inputPaths = argv + 1;
+	numInputs = 0;
 
 	if (argc < 2) {
-		printf("Usage: tool inputPath.bg3d [-r] [-o outputName]\n");
+		printf("Usage: tool inputPath.bg3d... [-r] [-t] [-o outputName [-g] [-w] [-q] [-c] [-z level] [-m] [-b fit]]\n");
 		die();
 	}
 
 	for (int i = 1; i < argc; i++) {
-		if (argv[i][0] == '-') {
+		// a lone dash reads the model from stdin
+		if (argv[i][0] == '-' && argv[i][1] != '\0') {
 			char c = argv[i][1];
 
 			switch (c) {
@@ -26,6 +44,59 @@ void setArgState(int argc, char *argv[]) {
 				argState = argState | 0x01;
 				break;
 			}
+			case 't': {
+				argState = argState | 0x04;
+				break;
+			}
+			case 'g': {
+				argState = argState | 0x08;
+				break;
+			}
+			case 'w': {
+				argState = argState | 0x10;
+				break;
+			}
+			case 'q': {
+				argState = argState | 0x20;
+				break;
+			}
+			case 'c': {
+				argState = argState | 0x40;
+				break;
+			}
+			case 'z': {
+				argState = argState | 0x80;
+
+				// the level is a single digit
+				if (i + 1 >= argc || argv[i + 1][0] < '0' || argv[i + 1][0] > '9' || argv[i + 1][1] != '\0') {
+					printf("Usage: tool inputPath.bg3d... [-r] [-t] [-o outputName [-g] [-w] [-q] [-c] [-z level] [-m] [-b fit]]\n");
+					die();
+				}
+
+				textureLevel = argv[++i][0] - '0';
+				break;
+			}
+			case 'm': {
+				argState = argState | 0x100;
+				break;
+			}
+			case 'b': {
+				argState = argState | 0x200;
+
+				// range is quicker, cluster closer; they are numbered as in
+				// BG3DBlockCompression
+				if (i + 1 < argc && strcmp(argv[i + 1], "range") == 0) {
+					blockFit = 1;
+				} else if (i + 1 < argc && strcmp(argv[i + 1], "cluster") == 0) {
+					blockFit = 2;
+				} else {
+					printf("Usage: tool inputPath.bg3d... [-r] [-t] [-o outputName [-g] [-w] [-q] [-c] [-z level] [-m] [-b fit]]\n");
+					die();
+				}
+
+				i++;
+				break;
+			}
 			case 'o': {
 				argState = argState | 0x02;
 
@@ -36,15 +107,21 @@ void setArgState(int argc, char *argv[]) {
 				break;
 			}
 			default:
-				printf("Usage: tool inputPath.bg3d [-r] [-o outputName]\n");
+				printf("Usage: tool inputPath.bg3d... [-r] [-t] [-o outputName [-g] [-w] [-q] [-c] [-z level] [-m] [-b fit]]\n");
 				die();
 				return;
 			}
 		} else {
-			inputPath = argv[1];
+			inputPaths[numInputs++] = argv[i];
 		}
 
 	}
 
+	// -g, -w, -q, -c, -z, -m and -b only change what -o writes
+	if (numInputs == 0 || ((argState & 0x3f8) && !(argState & 0x02))) {
+		printf("Usage: tool inputPath.bg3d... [-r] [-t] [-o outputName [-g] [-w] [-q] [-c] [-z level] [-m] [-b fit]]\n");
+		die();
+	}
+
 	printf("Args: %x\n", argState);
 }
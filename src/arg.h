@@ -0,0 +1,16 @@
+#ifndef ARG_H
+#define ARG_H
+
+#include <stdint.h>
+
+extern uint16_t argState;
+extern char ** inputPaths;
+extern int numInputs;
+extern char * outputName;
+extern int textureLevel;
+extern int blockFit;
+
+void die();
+void setArgState(int argc, char *argv[]);
+
+#endif /* ARG_H */
@@ -0,0 +1,472 @@
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "common.h"
+
+// Compresses RGBA pixels into BC1 blocks, or BC3 where there's alpha to
+// keep: 4x4 texels in 8 or 16 bytes, which GPUs sample without unpacking.
+// Colors are fitted on the sRGB values themselves, since that's what the
+// hardware interpolates between.
+//
+// Range fit takes the two texels furthest apart along the block's main axis
+// of color as its endpoints. Cluster fit tries every way of splitting the
+// texels, in their order along that axis, between the four colors a block
+// can have, and solves for the endpoints that suit each split best. It's
+// far slower and noticeably closer on gradients.
+
+// The most threads one level is compressed on.
+#define MAX_BLOCK_THREADS 16
+
+// Levels smaller than this are done on the calling thread alone.
+#define THREADED_BLOCKS 1024
+
+typedef struct {
+	float colors[16][3];
+	uint8_t alphas[16];
+} BlockTexels;
+
+// Gathers the block at bx, by, repeating the last row and column where it
+// runs off the edge.
+static void loadBlock (BlockTexels * block, const uint8_t * pixels, uint32_t width, uint32_t height, uint32_t bx, uint32_t by) {
+	for (uint32_t y = 0; y < 4; y++) {
+		uint32_t sy = by * 4 + y < height ? by * 4 + y : height - 1;
+
+		for (uint32_t x = 0; x < 4; x++) {
+			uint32_t sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+			const uint8_t * p = pixels + ((size_t) sy * width + sx) * 4;
+
+			for (int j = 0; j < 3; j++) {
+				block->colors[y * 4 + x][j] = p[j];
+			}
+
+			block->alphas[y * 4 + x] = p[3];
+		}
+	}
+}
+
+static uint16_t packColor (const float * c) {
+	int r = (int) lrintf(fminf(fmaxf(c[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+	int g = (int) lrintf(fminf(fmaxf(c[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+	int b = (int) lrintf(fminf(fmaxf(c[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+
+	return r << 11 | g << 5 | b;
+}
+
+// Widens a 5:6:5 color the way the hardware does.
+static void unpackColor (uint16_t packed, float * c) {
+	int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+
+	c[0] = (r << 3 | r >> 2);
+	c[1] = (g << 2 | g >> 4);
+	c[2] = (b << 3 | b >> 2);
+}
+
+static float colorDistance (const float * a, const float * b) {
+	float dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+	return dr * dr + dg * dg + db * db;
+}
+
+// The direction the block's colors spread along most, found by power
+// iteration on their covariance.
+static void principalAxis (const BlockTexels * block, float * axis) {
+	float mean[3] = { 0 };
+	float covariance[6] = { 0 };
+
+	for (int i = 0; i < 16; i++) {
+		for (int j = 0; j < 3; j++) {
+			mean[j] += block->colors[i][j] / 16.0f;
+		}
+	}
+
+	for (int i = 0; i < 16; i++) {
+		float r = block->colors[i][0] - mean[0];
+		float g = block->colors[i][1] - mean[1];
+		float b = block->colors[i][2] - mean[2];
+
+		covariance[0] += r * r;
+		covariance[1] += r * g;
+		covariance[2] += r * b;
+		covariance[3] += g * g;
+		covariance[4] += g * b;
+		covariance[5] += b * b;
+	}
+
+	// the search starts from the channel that spreads most: a fixed start,
+	// like gray, can be at right angles to the block's colors, and then it
+	// never moves
+	static const int rows[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+	int widest = covariance[3] > covariance[0] ? 1 : 0;
+	widest = covariance[5] > covariance[rows[widest][widest]] ? 2 : widest;
+
+	float v[3];
+
+	for (int j = 0; j < 3; j++) {
+		v[j] = covariance[rows[widest][j]];
+	}
+
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float x = v[0] * covariance[0] + v[1] * covariance[1] + v[2] * covariance[2];
+		float y = v[0] * covariance[1] + v[1] * covariance[3] + v[2] * covariance[4];
+		float z = v[0] * covariance[2] + v[1] * covariance[4] + v[2] * covariance[5];
+		float largest = fmaxf(fabsf(x), fmaxf(fabsf(y), fabsf(z)));
+
+		// a block of one color has no axis, and any will do
+		if (largest == 0.0f) {
+			break;
+		}
+
+		v[0] = x / largest;
+		v[1] = y / largest;
+		v[2] = z / largest;
+	}
+
+	memcpy(axis, v, sizeof(v));
+}
+
+static float project (const float * color, const float * axis) {
+	return color[0] * axis[0] + color[1] * axis[1] + color[2] * axis[2];
+}
+
+// Picks the nearest of the four colors c0 and c1 make for every texel, and
+// adds up how far off they are. The first endpoint has to be the larger,
+// which keeps BC1 in its four color mode; equal ones only have one color
+// worth using.
+static uint32_t colorIndices (const BlockTexels * block, uint16_t c0, uint16_t c1, float * error) {
+	float palette[4][3];
+	unpackColor(c0, palette[0]);
+	unpackColor(c1, palette[1]);
+
+	for (int j = 0; j < 3; j++) {
+		palette[2][j] = (2.0f * palette[0][j] + palette[1][j]) / 3.0f;
+		palette[3][j] = (palette[0][j] + 2.0f * palette[1][j]) / 3.0f;
+	}
+
+	uint32_t indices = 0;
+	*error = 0.0f;
+
+	for (int i = 0; i < 16; i++) {
+		int best = 0;
+		float bestDistance = colorDistance(block->colors[i], palette[0]);
+
+		for (int k = 1; k < 4 && c0 != c1; k++) {
+			float distance = colorDistance(block->colors[i], palette[k]);
+
+			if (distance < bestDistance) {
+				best = k;
+				bestDistance = distance;
+			}
+		}
+
+		indices |= (uint32_t) best << (2 * i);
+		*error += bestDistance;
+	}
+
+	return indices;
+}
+
+// The texels at either end of the axis.
+static void rangeFit (const BlockTexels * block, const float * axis, uint16_t * c0, uint16_t * c1) {
+	int lowest = 0, highest = 0;
+	float low = project(block->colors[0], axis), high = low;
+
+	for (int i = 1; i < 16; i++) {
+		float t = project(block->colors[i], axis);
+
+		if (t < low) {
+			low = t;
+			lowest = i;
+		}
+
+		if (t > high) {
+			high = t;
+			highest = i;
+		}
+	}
+
+	*c0 = packColor(block->colors[highest]);
+	*c1 = packColor(block->colors[lowest]);
+}
+
+// With the texels sorted along the axis, the first i go to the first
+// endpoint, up to j to the color a third of the way along, up to k to the
+// one two thirds along, and the rest to the second endpoint. Each split's
+// endpoints are solved for by least squares, snapped to 5:6:5 and scored
+// by the squared error that leaves, less what's the same for every split.
+static void clusterFit (const BlockTexels * block, const float * axis, uint16_t * c0, uint16_t * c1) {
+	int order[16];
+	float keys[16];
+
+	for (int i = 0; i < 16; i++) {
+		float t = project(block->colors[i], axis);
+		int k = i;
+
+		for (; k > 0 && keys[k - 1] < t; k--) {
+			keys[k] = keys[k - 1];
+			order[k] = order[k - 1];
+		}
+
+		keys[k] = t;
+		order[k] = i;
+	}
+
+	float sums[17][3] = { { 0 } };
+
+	for (int i = 0; i < 16; i++) {
+		for (int j = 0; j < 3; j++) {
+			sums[i + 1][j] = sums[i][j] + block->colors[order[i]][j];
+		}
+	}
+
+	float bestError = INFINITY;
+
+	for (int i = 0; i <= 16; i++) {
+		for (int j = i; j <= 16; j++) {
+			for (int k = j; k <= 16; k++) {
+				float n1 = j - i, n2 = k - j;
+				float alpha2 = i + n1 * (4.0f / 9.0f) + n2 * (1.0f / 9.0f);
+				float beta2 = (16 - k) + n2 * (4.0f / 9.0f) + n1 * (1.0f / 9.0f);
+				float alphaBeta = (n1 + n2) * (2.0f / 9.0f);
+				float determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+
+				// everything at one end leaves the other free
+				if (determinant < 1e-6f) {
+					continue;
+				}
+
+				float alphaX[3], betaX[3], a[3], b[3], error = 0.0f;
+
+				for (int c = 0; c < 3; c++) {
+					float s1 = sums[j][c] - sums[i][c], s2 = sums[k][c] - sums[j][c];
+
+					alphaX[c] = sums[i][c] + s1 * (2.0f / 3.0f) + s2 * (1.0f / 3.0f);
+					betaX[c] = (sums[16][c] - sums[k][c]) + s2 * (2.0f / 3.0f) + s1 * (1.0f / 3.0f);
+					a[c] = (alphaX[c] * beta2 - betaX[c] * alphaBeta) / determinant;
+					b[c] = (betaX[c] * alpha2 - alphaX[c] * alphaBeta) / determinant;
+				}
+
+				uint16_t p0 = packColor(a), p1 = packColor(b);
+				unpackColor(p0, a);
+				unpackColor(p1, b);
+
+				for (int c = 0; c < 3; c++) {
+					error += a[c] * a[c] * alpha2 + b[c] * b[c] * beta2 +
+					         2.0f * (a[c] * b[c] * alphaBeta - a[c] * alphaX[c] - b[c] * betaX[c]);
+				}
+
+				if (error < bestError) {
+					bestError = error;
+					*c0 = p0;
+					*c1 = p1;
+				}
+			}
+		}
+	}
+}
+
+static uint8_t * putColorBlock (uint8_t * out, const BlockTexels * block, BG3DBlockCompression fit) {
+	float axis[3];
+	principalAxis(block, axis);
+
+	uint16_t c0, c1;
+	rangeFit(block, axis, &c0, &c1);
+
+	if (c0 < c1) {
+		uint16_t swap = c0;
+		c0 = c1;
+		c1 = swap;
+	}
+
+	float error;
+	uint32_t indices = colorIndices(block, c0, c1, &error);
+
+	// blocks of one or two colors are often exact already
+	if (fit == BG3D_BLOCKS_CLUSTER_FIT && error > 0.0f) {
+		uint16_t k0 = c0, k1 = c1;
+		clusterFit(block, axis, &k0, &k1);
+
+		if (k0 < k1) {
+			uint16_t swap = k0;
+			k0 = k1;
+			k1 = swap;
+		}
+
+		// snapping can make the range fit's texels the better choice
+		float clusterError;
+		uint32_t clusterIndices = colorIndices(block, k0, k1, &clusterError);
+
+		if (clusterError < error) {
+			c0 = k0;
+			c1 = k1;
+			indices = clusterIndices;
+		}
+	}
+
+	out[0] = c0 & 0xff;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xff;
+	out[3] = c1 >> 8;
+
+	for (int i = 0; i < 4; i++) {
+		out[4 + i] = indices >> (8 * i);
+	}
+
+	return out + 8;
+}
+
+// The eight alphas a0 and a1 make, interpolated the way BC3 does: six
+// steps between them when a0 is larger, or four plus 0 and 255 when not.
+static void alphaPalette (uint8_t * palette, int a0, int a1) {
+	palette[0] = a0;
+	palette[1] = a1;
+
+	if (a0 > a1) {
+		for (int i = 1; i < 7; i++) {
+			palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+		}
+	} else {
+		for (int i = 1; i < 5; i++) {
+			palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+		}
+
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static uint64_t alphaIndices (const BlockTexels * block, int a0, int a1, uint32_t * error) {
+	uint8_t palette[8];
+	alphaPalette(palette, a0, a1);
+
+	uint64_t indices = 0;
+	*error = 0;
+
+	for (int i = 0; i < 16; i++) {
+		int best = 0, bestDistance = 256;
+
+		for (int k = 0; k < 8; k++) {
+			int distance = abs(block->alphas[i] - palette[k]);
+
+			if (distance < bestDistance) {
+				best = k;
+				bestDistance = distance;
+			}
+		}
+
+		indices |= (uint64_t) best << (3 * i);
+		*error += bestDistance * bestDistance;
+	}
+
+	return indices;
+}
+
+// Tries the block's whole range of alpha across six steps, and the range
+// of everything but 0 and 255 across four with those two kept exact, which
+// suits cutouts.
+static uint8_t * putAlphaBlock (uint8_t * out, const BlockTexels * block) {
+	int low = 255, high = 0, innerLow = 255, innerHigh = 0;
+
+	for (int i = 0; i < 16; i++) {
+		int a = block->alphas[i];
+
+		low = a < low ? a : low;
+		high = a > high ? a : high;
+
+		if (a != 0 && a != 255) {
+			innerLow = a < innerLow ? a : innerLow;
+			innerHigh = a > innerHigh ? a : innerHigh;
+		}
+	}
+
+	if (innerLow > innerHigh) {
+		innerLow = 0;
+		innerHigh = 255;
+	}
+
+	uint32_t error, innerError;
+	uint64_t indices = alphaIndices(block, high, low, &error);
+	uint64_t innerIndices = alphaIndices(block, innerLow, innerHigh, &innerError);
+
+	out[0] = high;
+	out[1] = low;
+
+	if (innerError < error) {
+		out[0] = innerLow;
+		out[1] = innerHigh;
+		indices = innerIndices;
+	}
+
+	for (int i = 0; i < 6; i++) {
+		out[2 + i] = indices >> (8 * i);
+	}
+
+	return out + 8;
+}
+
+// Levels are shared out between threads a row of blocks at a time.
+typedef struct {
+	uint8_t * blocks;
+	const uint8_t * pixels;
+	uint32_t width;
+	uint32_t height;
+	bool alpha;
+	BG3DBlockCompression fit;
+	uint32_t next;
+} BlockJobs;
+
+static void * compressRows (void * arg) {
+	BlockJobs * jobs = arg;
+	uint32_t blocksWide = (jobs->width + 3) / 4;
+	uint32_t blocksHigh = (jobs->height + 3) / 4;
+	size_t blockSize = jobs->alpha ? 16 : 8;
+	uint32_t by;
+
+	while ((by = __atomic_fetch_add(&jobs->next, 1, __ATOMIC_RELAXED)) < blocksHigh) {
+		uint8_t * out = jobs->blocks + (size_t) by * blocksWide * blockSize;
+
+		for (uint32_t bx = 0; bx < blocksWide; bx++) {
+			BlockTexels block;
+			loadBlock(&block, jobs->pixels, jobs->width, jobs->height, bx, by);
+
+			if (jobs->alpha) {
+				out = putAlphaBlock(out, &block);
+			}
+
+			out = putColorBlock(out, &block, jobs->fit);
+		}
+	}
+
+	return NULL;
+}
+
+// Compresses a width by height level of RGBA pixels into rows of BC1
+// blocks, or BC3 ones if alpha is set. Big levels are spread over up to
+// maxThreads threads, the calling one included, so that callers already
+// running side by side can share the processors out between them.
+void compressBlocks (uint8_t * blocks, const uint8_t * pixels, uint32_t width, uint32_t height, bool alpha, BG3DBlockCompression fit, int maxThreads) {
+	BlockJobs jobs = { blocks, pixels, width, height, alpha, fit, 0 };
+	pthread_t threads[MAX_BLOCK_THREADS];
+	long numThreads = 0;
+
+	uint64_t numBlocks = (uint64_t) ((width + 3) / 4) * ((height + 3) / 4);
+
+	if (numBlocks >= THREADED_BLOCKS) {
+		long wanted = maxThreads - 1;
+
+		if (wanted > MAX_BLOCK_THREADS) {
+			wanted = MAX_BLOCK_THREADS;
+		}
+
+		for (; numThreads < wanted; numThreads++) {
+			if (pthread_create(&threads[numThreads], NULL, compressRows, &jobs) != 0) {
+				break;
+			}
+		}
+	}
+
+	compressRows(&jobs);
+
+	for (long i = 0; i < numThreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+}
@@ -1,373 +1,588 @@
-#include "bg3d.h"
+#include <stddef.h>
+#include <string.h>
+
+#include "common.h"
+#include "layout.h"
+
+const char * variantNames[] = {
+	"otto matic",
+	"book",
+	"unknown"
+};
+
+static uint32_t loadU32 (const uint8_t * view) {
+	uint32_t value;
+	memcpy(&value, view, 4);
+	return be32toh(value);
+}
+
+// Checks that size bytes of pixels fit a width by height texture with one
+// to four bytes per pixel.
+static bool plausibleTextureSize (uint32_t width, uint32_t height, uint32_t size) {
+	uint64_t pixels = (uint64_t) width * height;
+	return pixels > 0 && size > 0 && size % pixels == 0 && size / pixels <= 4;
+}
+
+static bool arrayTagAt (const uint8_t * view, size_t size, size_t pos) {
+	if (pos + 4 > size) {
+		return false;
+	}
+
+	uint32_t tag = loadU32(view + pos);
+	return tag >= BG3D_TAGTYPE_VERTEXARRAY && tag <= BG3D_TAGTYPE_TRIANGLEARRAY;
+}
+
+static bool tagAt (const uint8_t * view, size_t size, uint64_t pos) {
+	return pos + 4 <= size && loadU32(view + pos) <= BG3D_TAGTYPE_ENDFILE;
+}
+
+static BG3DVariant detectFromTexture (const uint8_t * view, size_t size) {
+	if (size < sizeof(BG3DBookTextureHeader)) {
+		return BG3D_VARIANT_UNKNOWN;
+	}
+
+	uint32_t width = loadU32(view), height = loadU32(view + 4);
+	uint32_t bookSize = loadU32(view + offsetof(BG3DBookTextureHeader, bufferSize));
+	bool book = plausibleTextureSize(width, height, bookSize);
+	bool otto = false;
+	uint32_t ottoSize = 0;
+
+	if (size >= sizeof(BG3DOttoTextureHeader)) {
+		uint32_t format = loadU32(view + offsetof(BG3DOttoTextureHeader, srcPixelFormat));
+		ottoSize = loadU32(view + offsetof(BG3DOttoTextureHeader, bufferSize));
+
+		// Otto Matic stores OpenGL pixel formats where the book has the size
+		otto = format >= 0x1900 && format < 0x9000 && plausibleTextureSize(width, height, ottoSize);
+	}
 
-json_object * outputJSON;
+	if (book && otto) {
+		// fall back on which layout lands on a tag after the pixels
+		book = tagAt(view, size, sizeof(BG3DBookTextureHeader) + (uint64_t) bookSize);
+		otto = tagAt(view, size, sizeof(BG3DOttoTextureHeader) + (uint64_t) ottoSize);
+	}
+
+	if (otto) {
+		return BG3D_VARIANT_OTTOMATIC;
+	}
+
+	return book ? BG3D_VARIANT_BOOK : BG3D_VARIANT_UNKNOWN;
+}
+
+static BG3DVariant detectFromMesh (const uint8_t * view, size_t size) {
+	bool book = arrayTagAt(view, size, sizeof(BG3DBookMeshHeader));
+	bool otto = arrayTagAt(view, size, sizeof(BG3DOttoMeshHeader));
+
+	// the book's header could line up by chance, Otto Matic's layer count can't
+	if (otto && (!book || loadU32(view + offsetof(BG3DOttoMeshHeader, numMaterials)) <= 4)) {
+		return BG3D_VARIANT_OTTOMATIC;
+	}
 
-void readHeader (FILE * pFile) {
+	return book ? BG3D_VARIANT_BOOK : BG3D_VARIANT_UNKNOWN;
+}
+
+// Works out the layout from the first texture or geometry header after the
+// reader's position, without moving it. Files with neither are unknown, but
+// then nothing in them depends on the layout. A stream is only looked at as
+// far as its window reaches.
+BG3DVariant detectVariant (BG3DReader * pReader) {
+	size_t size = peekBytes(pReader, SIZE_MAX);
+	const uint8_t * view = pReader->data + (pReader->pos - pReader->base);
+	size_t pos = 0;
+
+	while (pos + 4 <= size) {
+		uint32_t tag = loadU32(view + pos);
+		pos += 4;
+
+		switch (tag) {
+		case BG3D_TAGTYPE_MATERIALFLAGS: {
+			pos += 4;
+			break;
+		}
+		case BG3D_TAGTYPE_MATERIALDIFFUSECOLOR: {
+			pos += 16;
+			break;
+		}
+		case BG3D_TAGTYPE_GROUPSTART:
+		case BG3D_TAGTYPE_GROUPEND: {
+			break;
+		}
+		case BG3D_TAGTYPE_TEXTUREMAP: {
+			return detectFromTexture(view + pos, size - pos);
+		}
+		case BG3D_TAGTYPE_GEOMETRY: {
+			return detectFromMesh(view + pos, size - pos);
+		}
+		default:
+			return BG3D_VARIANT_UNKNOWN;
+		}
+	}
+
+	return BG3D_VARIANT_UNKNOWN;
+}
+
+BG3DError readHeader (BG3DReader * pReader, BG3DModel * model) {
 	BG3DHeaderType header;
-	size_t result;
 
-	result = fread(header.headerString, 1, 16, pFile);
+	const void * view = readBytes(pReader, 16);
 
-	if (result < 16) {
-		perror("Error Reading BG3D Header String.\n");
-		die();
+	if (view == NULL) {
+		return setError(pReader, BG3D_ERROR_TRUNCATED, "Error Reading BG3D Header String.");
 	}
 
-	result = fread(&(header.version), 1, 4, pFile);
+	memcpy(header.headerString, view, 16);
 
-	if (result < 4) {
-		perror("Error Reading BG3D Header Version.\n");
-		die();
+	view = readBytes(pReader, 4);
+
+	if (view == NULL) {
+		return setError(pReader, BG3D_ERROR_TRUNCATED, "Error Reading BG3D Header Version.");
 	}
-  			
+
+	memcpy(&(header.version), view, 4);
+
 	if ((header.headerString[0] != 'B') || (header.headerString[1] != 'G') ||
 	    (header.headerString[2] != '3') || (header.headerString[3] != 'D')) {
-		perror("Error: BG3D file has invalid header.\n");
-		die();
+		pReader->pos = 0;
+		return setError(pReader, BG3D_ERROR_BAD_HEADER, "BG3D file has invalid header.");
+	}
+
+	model->header = header;
+	model->variant = detectVariant(pReader);
+
+	if (pReader->report) {
+		fprintf(pReader->report, "Header: %.16s\n", header.headerString);
+		long pos = pReader->pos - 4;
+		fprintf(pReader->report, "%8lx: %u (version)\n", pos, header.version);
+		fprintf(pReader->report, "Variant: %s\n", variantNames[model->variant]);
 	}
 
-	extern uint8_t argState;
-	if (argState & 1) {
-		printf("Header: %s\n", header.headerString);
-		long pos = ftell(pFile) - result;
-		printf("%8lx: %u (version)\n", pos, header.version);
+	// with nothing to tell them apart, either layout reads the file
+	if (model->variant == BG3D_VARIANT_UNKNOWN) {
+		model->variant = BG3D_VARIANT_OTTOMATIC;
 	}
 
-	if (argState & 2) {
-		extern json_object * outputJSON;
-		outputJSON = json_object_new_object();
+	return BG3D_OK;
+}
+
+static BG3DError readTextureMapAs (BG3DReader *, BG3DModel *, BG3DVariant);
+static BG3DError readNewMeshAs (BG3DReader *, BG3DModel *, BG3DVariant);
 
-		json_object * asset = json_object_new_object();
-		json_object * version = json_object_new_string("2.0");
+// Ends the current group, passing its bounds on to its parent, or to the
+// model's at the top.
+static void closeGroup (BG3DModel * model) {
+	BG3DGroup * group = &model->groups[model->currentGroup];
 
-		json_object_object_add(asset, "version", version);
-		json_object_object_add(outputJSON, "asset", asset);
+	if (group->parent >= 0) {
+		mergeBounds(&model->groups[group->parent].bounds, &group->bounds);
+	} else {
+		mergeBounds(&model->bounds, &group->bounds);
 	}
+
+	model->currentGroup = group->parent;
 }
 
-void parseFile (FILE * pFile) {
+LAYOUT_INLINE BG3DError parseTags (BG3DReader * pReader, BG3DModel * model, const BG3DVariant variant) {
+	BG3DError error = BG3D_OK;
 	uint32_t tag;
-	size_t count;
-	bool done = false;
-	BG3DMeshHeader * newObjHeader;
 
 	do {
-		count = sizeof(tag);
-		size_t result = fread(&tag, 1, count, pFile);
+		long pos = pReader->pos;
 
-		if (result < count) {
-			perror("Error Reading a BG3D Tag.\n");
-			die();
+		if (!readU32(pReader, &tag)) {
+			return setError(pReader, BG3D_ERROR_TRUNCATED, "Error Reading a BG3D Tag.");
 		}
 
-		tag = htobe32(tag);
-
-		extern uint8_t argState;
-		if (argState & 1) {
-			long pos = ftell(pFile) - result;
-			printf("%8lx: %u (tag)\n", pos, tag);
+		if (pReader->report) {
+			fprintf(pReader->report, "%8lx: %u (tag)\n", pos, tag);
 		}
 
 		switch (tag) {
 		case BG3D_TAGTYPE_MATERIALFLAGS: {
-			readMaterialFlags(pFile);
+			error = readMaterialFlags(pReader, model);
 			break;
 		}
 		case BG3D_TAGTYPE_MATERIALDIFFUSECOLOR: {
-			readMaterialDiffuseColor(pFile);
+			error = readMaterialDiffuseColor(pReader, model);
 			break;
 		}
 		case BG3D_TAGTYPE_TEXTUREMAP: {
-			readMaterialTextureMap(pFile);
+			error = readTextureMapAs(pReader, model, variant);
 			break;
 		}
 		case BG3D_TAGTYPE_GROUPSTART: {
-			readGroup();
+			error = readGroup(pReader, model);
 			break;
 		}
 		case BG3D_TAGTYPE_GROUPEND: {
-			endGroup();
+			error = endGroup(pReader, model);
 			break;
 		}
 		case BG3D_TAGTYPE_GEOMETRY: {
-			newObjHeader = readNewMesh(pFile);
+			error = readNewMeshAs(pReader, model, variant);
 			break;
 		}
 		case BG3D_TAGTYPE_VERTEXARRAY: {
-			readVertexArray(pFile, newObjHeader);
+			error = readVertexArray(pReader, model);
 			break;
 		}
 		case BG3D_TAGTYPE_NORMALARRAY: {
-			readNormalArray(pFile, newObjHeader);
+			error = readNormalArray(pReader, model);
 			break;
 		}
 		case BG3D_TAGTYPE_UVARRAY: {
-			readUVArray(pFile, newObjHeader);
+			error = readUVArray(pReader, model);
 			break;
 		}
 		case BG3D_TAGTYPE_COLORARRAY: {
-			readVertexColorArray(pFile, newObjHeader);
+			error = readVertexColorArray(pReader, model);
 			break;
 		}
 		case BG3D_TAGTYPE_TRIANGLEARRAY: {
-			readTriangleArray(pFile, newObjHeader);
+			error = readTriangleArray(pReader, model);
 			break;
 		}
 		case BG3D_TAGTYPE_ENDFILE: {
-			done = true;
-			break;
+			// groups the file never ended still pass their bounds up
+			while (model->currentGroup >= 0) {
+				closeGroup(model);
+			}
+
+			return BG3D_OK;
 		}
 		default:
-			perror("Error: Unrecognized Tag.\n");
-			die();
+			pReader->pos = pos;
+			return setError(pReader, BG3D_ERROR_BAD_TAG, "Unrecognized Tag.");
 		}
-	} while (!done);
+	} while (error == BG3D_OK);
+
+	return error;
+}
+
+// The loop is compiled once per variant, with its header layouts fixed.
+BG3DError parseFile (BG3DReader * pReader, BG3DModel * model) {
+	if (model->variant == BG3D_VARIANT_BOOK) {
+		return parseTags(pReader, model, BG3D_VARIANT_BOOK);
+	}
 
-	free(newObjHeader);
+	return parseTags(pReader, model, BG3D_VARIANT_OTTOMATIC);
 }
 
 // Tag 0
-void readMaterialFlags (FILE * pFile) {
-	size_t count;
+BG3DError readMaterialFlags (BG3DReader * pReader, BG3DModel * model) {
 	uint32_t flags;
+	long pos = pReader->pos;
 
-	count = sizeof(flags);
-	size_t result = fread(&flags, 1, count, pFile);
+	if (!readU32(pReader, &flags)) {
+		return setError(pReader, BG3D_ERROR_TRUNCATED, "Error Reading Material Flags.");
+	}
 
-	if (result < count) {
-		perror("Error Reading Material Flags.\n");
-		die();
+	if (pReader->report) {
+		fprintf(pReader->report, "%8lx: %u (flags)\n", pos, flags);
 	}
 
-	flags = htobe32(flags);
+	// each set of flags starts a new material
+	BG3DMaterial * material = addMaterial(model);
 
-	extern uint8_t argState;
-	if (argState & 1) {
-		long pos = ftell(pFile) - result;
-		printf("%8lx: %u (flags)\n", pos, flags);
+	if (material == NULL) {
+		return setError(pReader, BG3D_ERROR_MEMORY, "Error Adding a Material.");
 	}
+
+	material->flags = flags;
+	return BG3D_OK;
 }
 
 // Tag 1
-void readMaterialDiffuseColor (FILE * pFile) {
-	size_t count;
+BG3DError readMaterialDiffuseColor (BG3DReader * pReader, BG3DModel * model) {
 	uint32_t color[4];
+	long pos = pReader->pos;
 
-	count = sizeof(uint32_t) * 4;
-	size_t result = fread(color, 1, 16, pFile);
-
-	if (result < count) {
-		perror("Error Reading Diffuse Color\n");
-		die();
+	for (int i = 0; i < 4; i++) {
+		if (!readU32(pReader, &color[i])) {
+			return setError(pReader, BG3D_ERROR_TRUNCATED, "Error Reading Diffuse Color.");
+		}
 	}
 
-	for (int i = 0; i < 4; i++) {
-		color[i] = htobe32(color[i]);
+	// the components are GLfloats
+	float diffuseColor[4];
+	memcpy(diffuseColor, color, sizeof(color));
+
+	if (pReader->report) {
+		fprintf(pReader->report, "%8lx: %g (diffuse color r)\n", pos, diffuseColor[0]);
+		fprintf(pReader->report, "%8lx: %g (diffuse color g)\n", pos + 4, diffuseColor[1]);
+		fprintf(pReader->report, "%8lx: %g (diffuse color b)\n", pos + 8, diffuseColor[2]);
+		fprintf(pReader->report, "%8lx: %g (diffuse color a)\n", pos + 12, diffuseColor[3]);
 	}
 
-	extern uint8_t argState;
-	if (argState & 1) {
-		long pos = ftell(pFile) - result;
-		printf("%8lx: %x (diffuse color r)\n", pos, color[0]);
-		printf("%8lx: %x (diffuse color g)\n", pos + 4, color[1]);
-		printf("%8lx: %x (diffuse color b)\n", pos + 8, color[2]);
-		printf("%8lx: %x (diffuse color a)\n", pos + 12, color[3]);
+	if (model->numMaterials == 0) {
+		pReader->pos = pos;
+		return setError(pReader, BG3D_ERROR_STRUCTURE, "Diffuse Color Outside a Material.");
 	}
+
+	memcpy(model->materials[model->numMaterials - 1].diffuseColor, diffuseColor, sizeof(diffuseColor));
+	return BG3D_OK;
 }
 
 // Tag 2
-void readMaterialTextureMap (FILE * pFile) {
+LAYOUT_INLINE BG3DError readTextureMapAs (BG3DReader * pReader, BG3DModel * model, const BG3DVariant variant) {
 	BG3DTextureHeader header;
-	size_t count = sizeof(header);
+	long pos = pReader->pos;
 
-	size_t result = fread(&header, 1, count, pFile);
+	const void * view = readBytes(pReader, textureHeaderSize(variant));
 
-	if (result < count) {
-		perror("Error Reading Texture Header.\n");
-		die();
+	if (view == NULL) {
+		return setError(pReader, BG3D_ERROR_TRUNCATED, "Error Reading Texture Header.");
 	}
 
-	header.width = htobe32(header.width);
-	header.height = htobe32(header.height);
-	header.bufferSize = htobe32(header.bufferSize);
+	decodeTextureHeader(view, variant, &header);
+
+	if (pReader->report) {
+		fprintf(pReader->report, "%8lx: %u (width)\n", pos + TEXTURE_FIELD_OFFSET(variant, width), header.width);
+		fprintf(pReader->report, "%8lx: %u (height)\n", pos + TEXTURE_FIELD_OFFSET(variant, height), header.height);
 
-	extern uint8_t argState;
-	if (argState & 1) {
-		long pos = ftell(pFile) - result;
-		printf("%8lx: %u (width)\n", pos, header.width);
-		printf("%8lx: %u (height)\n", pos + 4, header.height);
-		printf("%8lx: 0x%x (size)\n", pos + 8, header.bufferSize);
-		printf("%8lx: Beginning of Texture Data\n", pos + result);
+		if (variant == BG3D_VARIANT_OTTOMATIC) {
+			fprintf(pReader->report, "%8lx: 0x%x (srcPixelFormat)\n", pos + offsetof(BG3DOttoTextureHeader, srcPixelFormat), header.srcPixelFormat);
+			fprintf(pReader->report, "%8lx: 0x%x (dstPixelFormat)\n", pos + offsetof(BG3DOttoTextureHeader, dstPixelFormat), header.dstPixelFormat);
+		}
+
+		fprintf(pReader->report, "%8lx: 0x%x (size)\n", pos + TEXTURE_FIELD_OFFSET(variant, bufferSize), header.bufferSize);
+		fprintf(pReader->report, "%8lx: Beginning of Texture Data\n", pReader->pos);
 	}
 
-	count = header.bufferSize;
-	void * buffer = malloc(count);
+	const uint8_t * buffer = NULL;
 
-	result = fread(buffer, 1, count, pFile);
+	// the pixels are viewed in place; they stay valid while the file is mapped
+	if (pReader->metadataOnly) {
+		if (!skipBytes(pReader, header.bufferSize)) {
+			return setError(pReader, BG3D_ERROR_TRUNCATED, "Error Skipping Texture Pixels.");
+		}
+	} else if ((buffer = readPayload(pReader, &model->arena, header.bufferSize)) == NULL) {
+		return setError(pReader, BG3D_ERROR_TRUNCATED, "Error Reading Texture Pixels.");
+	}
 
-	if (result < count) {
-		perror("Error Reading Texture Pixels.\n");
-		die();
+	if (model->numMaterials == 0) {
+		pReader->pos = pos;
+		return setError(pReader, BG3D_ERROR_STRUCTURE, "Texture Outside a Material.");
 	}
 
-	if (argState & 2) {
-		// get the texture output file name
-		extern char * outputName;
-		char outputPathTexture[100] = "";
-		snprintf(outputPathTexture, 100, "%s.bmp", outputName);
+	BG3DTexture * texture = addTexture(model);
 
-		// create bitmap structure
-		Bitmap * b = bm_create(header.width, header.height);
+	if (texture == NULL) {
+		return setError(pReader, BG3D_ERROR_MEMORY, "Error Adding a Texture.");
+	}
 
-		char * pColorComponent = (char *) buffer;
-		for (int r = 0; r < header.width; r++) {
-			for (int c = 0; c < header.height; c++) {
-				char aComp = 0xff;
-				char rComp = *(pColorComponent++);
-				char gComp = *(pColorComponent++);
-				char bComp = *(pColorComponent++);
-				unsigned int color = aComp << 24 | rComp << 16 | gComp << 8 | bComp;
+	model->materials[model->numMaterials - 1].textureNum = model->numTextures - 1;
+	texture->header = header;
+	texture->pixels = buffer;
 
-				bm_set(b, r, c, color);
-			}
-		}
+	return BG3D_OK;
+}
 
-		// write bitmap and free it.
-		bm_save(b, outputPathTexture);
-		bm_free(b);
+BG3DError readMaterialTextureMap (BG3DReader * pReader, BG3DModel * model) {
+	if (model->variant == BG3D_VARIANT_BOOK) {
+		return readTextureMapAs(pReader, model, BG3D_VARIANT_BOOK);
 	}
 
-	free(buffer);
+	return readTextureMapAs(pReader, model, BG3D_VARIANT_OTTOMATIC);
 }
 
 // Tag 5
-BG3DMeshHeader * readNewMesh (FILE * pFile) {
-	size_t count = sizeof(BG3DMeshHeader);
-	BG3DMeshHeader * geoHeader = (BG3DMeshHeader *) malloc(count);
-	size_t result = fread(geoHeader, 1, count, pFile);
+LAYOUT_INLINE BG3DError readNewMeshAs (BG3DReader * pReader, BG3DModel * model, const BG3DVariant variant) {
+	long pos = pReader->pos;
 
-	if (result < count) {
-		perror("Error Reading Mesh Header.\n");
-		die();
+	const void * view = readBytes(pReader, meshHeaderSize(variant));
+
+	if (view == NULL) {
+		return setError(pReader, BG3D_ERROR_TRUNCATED, "Error Reading Mesh Header.");
 	}
 
-	geoHeader->materialNum = htobe32(geoHeader->materialNum);
-	geoHeader->flags = htobe32(geoHeader->flags);
-	geoHeader->numPoints = htobe32(geoHeader->numPoints);
-	geoHeader->numTriangles = htobe32(geoHeader->numTriangles);
+	BG3DMesh * mesh = addMesh(model);
 
-	extern uint8_t argState;
-	if (argState & 1) {
-		long pos = ftell(pFile) - 16;
-		printf("%8lx: %u (materialNum)\n", pos, geoHeader->materialNum);
-		printf("%8lx: %u (flags)\n", pos + 4, geoHeader->flags);
-		printf("%8lx: %u (numPoints)\n", pos + 8, geoHeader->numPoints);
-		printf("%8lx: %u (numTriangles)\n", pos + 12, geoHeader->numTriangles);
+	if (mesh == NULL) {
+		return setError(pReader, BG3D_ERROR_MEMORY, "Error Adding a Mesh.");
 	}
 
-	if (argState & 2) {
-		extern json_object * outputJSON;
+	BG3DMeshHeader * geoHeader = &mesh->header;
+	decodeMeshHeader(view, variant, geoHeader);
+
+	if (pReader->report) {
+		fprintf(pReader->report, "%8lx: %u (materialNum)\n", pos + MESH_FIELD_OFFSET(variant, materialNum, layerMaterialNum), geoHeader->materialNum);
+		fprintf(pReader->report, "%8lx: %u (flags)\n", pos + MESH_FIELD_OFFSET(variant, flags, flags), geoHeader->flags);
+		fprintf(pReader->report, "%8lx: %u (numPoints)\n", pos + MESH_FIELD_OFFSET(variant, numPoints, numPoints), geoHeader->numPoints);
+		fprintf(pReader->report, "%8lx: %u (numTriangles)\n", pos + MESH_FIELD_OFFSET(variant, numTriangles, numTriangles), geoHeader->numTriangles);
+	}
 
-		json_object * buffers = json_object_new_array();
-		json_object * currentBuffer = json_object_new_object();
+	return BG3D_OK;
+}
 
-		json_object_object_add(asset, "version", version);
-		json_object_object_add(outputJSON, "asset", asset);
+BG3DError readNewMesh (BG3DReader * pReader, BG3DModel * model) {
+	if (model->variant == BG3D_VARIANT_BOOK) {
+		return readNewMeshAs(pReader, model, BG3D_VARIANT_BOOK);
 	}
 
-	return geoHeader;
+	return readNewMeshAs(pReader, model, BG3D_VARIANT_OTTOMATIC);
 }
 
-// Tag 6
-void readVertexArray (FILE * pFile, BG3DMeshHeader * header) {
-	uint32_t numPoints = header->numPoints;
-	size_t count = numPoints * 12;
-	void * vertexArray = malloc(count);
+// Reads count big endian 32 bit values into a new native array. Only the
+// size is checked when reading metadata. Streams already copy the payload
+// into the arena, so it is swapped where it lies. With bounds given, the
+// values are points and are taken into the bounds as they are decoded.
+static BG3DError readArray32 (BG3DReader * pReader, BG3DArena * arena, size_t count, void * array, BG3DBounds * bounds,
+                              const char * message) {
+	if (pReader->metadataOnly) {
+		return skipBytes(pReader, count * 4) ? BG3D_OK : setError(pReader, BG3D_ERROR_TRUNCATED, message);
+	}
+
+	void * view = readPayload(pReader, arena, count * 4);
 
-	size_t result = fread(vertexArray, 1, count, pFile);
+	if (view == NULL) {
+		return setError(pReader, BG3D_ERROR_TRUNCATED, message);
+	}
+
+	void * decoded = pReader->window != NULL ? view : arenaAlloc(arena, count * 4);
+
+	if (decoded == NULL) {
+		return setError(pReader, BG3D_ERROR_MEMORY, message);
+	}
 
-	if (result < count) {
-		perror("Error Reading the Vertex Array.\n");
-		die();
+	if (bounds != NULL) {
+		decodePoints(decoded, view, count / 3, bounds);
+	} else {
+		decodeBigEndian32(decoded, view, count);
 	}
 
-	free(vertexArray);
+	*(void **) array = decoded;
+
+	return BG3D_OK;
 }
 
-// Tag 7
-void readNormalArray (FILE * pFile, BG3DMeshHeader * header) {
-	uint32_t numPoints = header->numPoints;
+// The arrays belong to the mesh of the last geometry tag.
+static BG3DMesh * currentMesh (BG3DReader * pReader, BG3DModel * model) {
+	if (model->numMeshes == 0) {
+		pReader->pos -= 4;
+		setError(pReader, BG3D_ERROR_STRUCTURE, "Array Before Any Geometry.");
+		return NULL;
+	}
 
-	size_t count = numPoints * 12;
-	void * normalArray = malloc(count);
+	return &model->meshes[model->numMeshes - 1];
+}
 
-	size_t result = fread(normalArray, 1, count, pFile);
+// Tag 6
+BG3DError readVertexArray (BG3DReader * pReader, BG3DModel * model) {
+	BG3DMesh * mesh = currentMesh(pReader, model);
+
+	if (mesh == NULL) {
+		return pReader->error;
+	}
+
+	BG3DError error = readArray32(pReader, &model->arena, (size_t) mesh->header.numPoints * 3, &mesh->points,
+	                              &mesh->bounds, "Error Reading the Vertex Array.");
 
-	if (result < count) {
-		perror("Error Reading the Vertex Array.\n");
-		die();
+	// groups pass their bounds on to their parents when they end
+	if (mesh->group >= 0) {
+		mergeBounds(&model->groups[mesh->group].bounds, &mesh->bounds);
+	} else {
+		mergeBounds(&model->bounds, &mesh->bounds);
 	}
 
-	free(normalArray);
+	return error;
 }
 
-// Tag 8
-void readUVArray (FILE * pFile, BG3DMeshHeader * header) {
-	uint32_t numPoints = header->numPoints;
+// Tag 7
+BG3DError readNormalArray (BG3DReader * pReader, BG3DModel * model) {
+	BG3DMesh * mesh = currentMesh(pReader, model);
 
-	size_t count = numPoints * 8;
-	void * uvList = malloc(count);
+	if (mesh == NULL) {
+		return pReader->error;
+	}
 
-	size_t result = fread(uvList, 1, count, pFile);
+	return readArray32(pReader, &model->arena, (size_t) mesh->header.numPoints * 3, &mesh->normals, NULL,
+	                   "Error Reading the Normal Array.");
+}
+
+// Tag 8
+BG3DError readUVArray (BG3DReader * pReader, BG3DModel * model) {
+	BG3DMesh * mesh = currentMesh(pReader, model);
 
-	if (result < count) {
-		perror("Error Reading the Vertex Array.\n");
-		die();
+	if (mesh == NULL) {
+		return pReader->error;
 	}
 
-	free(uvList);
+	return readArray32(pReader, &model->arena, (size_t) mesh->header.numPoints * 2, &mesh->uvs, NULL,
+	                   "Error Reading the UV Array.");
 }
 
 // Tag 9
-void readVertexColorArray (FILE * pFile, BG3DMeshHeader * header) {
-	uint32_t numPoints = header->numPoints;
+BG3DError readVertexColorArray (BG3DReader * pReader, BG3DModel * model) {
+	BG3DMesh * mesh = currentMesh(pReader, model);
 
-	size_t count = numPoints * 4;
-	void * vertexColorArray = malloc(count);
+	if (mesh == NULL) {
+		return pReader->error;
+	}
+
+	size_t count = (size_t) mesh->header.numPoints * 4;
+
+	if (pReader->metadataOnly) {
+		if (!skipBytes(pReader, count)) {
+			return setError(pReader, BG3D_ERROR_TRUNCATED, "Error Skipping the Vertex Color Array.");
+		}
 
-	size_t result = fread(vertexColorArray, 1, count, pFile);
+		return BG3D_OK;
+	}
 
-	if (result < count) {
-		perror("Error Reading the Vertex Color Array.\n");
-		die();
+	// the colors are single bytes and need no swapping, so they're used
+	// where they are, in the mapping or a stream's copy in the arena
+	if ((mesh->colors = readPayload(pReader, &model->arena, count)) == NULL) {
+		return setError(pReader, BG3D_ERROR_TRUNCATED, "Error Reading the Vertex Color Array.");
 	}
 
-	free(vertexColorArray);
+	return BG3D_OK;
 }
 
 // Tag 10
-void readTriangleArray (FILE * pFile, BG3DMeshHeader * header) {
-	uint32_t numPoints = header->numTriangles;
+BG3DError readTriangleArray (BG3DReader * pReader, BG3DModel * model) {
+	BG3DMesh * mesh = currentMesh(pReader, model);
 
-	size_t count = numPoints * 12;
-	void * triList = malloc(count);
+	if (mesh == NULL) {
+		return pReader->error;
+	}
 
-	size_t result = fread(triList, 1, count, pFile);
+	size_t count = (size_t) mesh->header.numTriangles * 3;
+	size_t start = pReader->pos;
+	BG3DError error = readArray32(pReader, &model->arena, count, &mesh->triangles, NULL,
+	                              "Error Reading the Triangle Array.");
 
-	if (result < count) {
-		perror("Error Reading the Triangle Array.\n");
-		die();
+	if (error != BG3D_OK || mesh->triangles == NULL) {
+		return error;
 	}
 
-	free(triList);
+	// everything downstream indexes the points with these, and narrows
+	// them to fit the point count
+	for (size_t i = 0; i < count; i++) {
+		if (mesh->triangles[i] >= mesh->header.numPoints) {
+			pReader->pos = start + i * 4;
+			return setError(pReader, BG3D_ERROR_STRUCTURE, "Triangle Index Out of Range.");
+		}
+	}
+
+	return BG3D_OK;
 }
 
 // Tag 3
-void readGroup (void) {
+BG3DError readGroup (BG3DReader * pReader, BG3DModel * model) {
+	if (addGroup(model) == NULL) {
+		return setError(pReader, BG3D_ERROR_MEMORY, "Error Adding a Group.");
+	}
 
+	model->currentGroup = model->numGroups - 1;
+	return BG3D_OK;
 }
 
 // Tag 4
-void endGroup (void) {
+BG3DError endGroup (BG3DReader * pReader, BG3DModel * model) {
+	if (model->currentGroup < 0) {
+		pReader->pos -= 4;
+		return setError(pReader, BG3D_ERROR_STRUCTURE, "Group End Without a Start.");
+	}
 
+	closeGroup(model);
+	return BG3D_OK;
 }
@@ -1,47 +1,188 @@
+#ifndef BG3D_H
+#define BG3D_H
+
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 
 #include <endian.h>
-#include <json-c/json_object.h>
 
-#include "common.c"
+// What went wrong while reading a file. Every reader that can fail returns
+// one of these, and the reader keeps the first failure with a message and
+// the offset it happened at, so a batch of files can carry on past a bad one.
+typedef enum {
+  BG3D_OK,
+  BG3D_ERROR_OPEN,
+  BG3D_ERROR_TRUNCATED,
+  BG3D_ERROR_BAD_HEADER,
+  BG3D_ERROR_BAD_TAG,
+  BG3D_ERROR_STRUCTURE,
+  BG3D_ERROR_MEMORY,
+  BG3D_ERROR_WRITE,
+  BG3D_ERROR_SEEK
+} BG3DError;
+
+// A cursor over a memory-mapped BG3D file. Payloads are handed out as views
+// into the mapping, so nothing is copied until a caller actually needs to.
+// When report is set, the parser prints every field it reads to it, along
+// with its offset. With metadataOnly set, texture and geometry payloads are
+// stepped over and left NULL in the model.
+//
+// Pipes can't be mapped, so they are read through a fixed size window
+// instead. Offsets are still counted from the start of the stream: data
+// holds the bytes from base up to size, and pos never moves backwards past
+// base.
+typedef struct {
+  const uint8_t * data;
+  size_t size;
+  size_t pos;
+  FILE * report;
+  bool metadataOnly;
+
+  int fd;
+  bool ownsFd;
+  uint8_t * window;
+  size_t base;
 
-#define BMPH_IMPLEMENTATION
-#include "bmph.h"
+  BG3DError error;
+  const char * errorMessage;
+  size_t errorOffset;
+} BG3DReader;
 
-#define OTTOMATIC
+// A monotonic allocator. Everything parsed from a file is carved out of one
+// arena, which is reset rather than freed between files.
+typedef struct BG3DArenaBlock BG3DArenaBlock;
+
+typedef struct {
+  BG3DArenaBlock * first;
+  BG3DArenaBlock * current;
+  void * last;
+} BG3DArena;
 
 typedef struct {
   char headerString[16];
   uint32_t version;
 } BG3DHeaderType;
 
+// Files from Otto Matic and the ones packaged with the book share a header
+// and version but lay out the texture and geometry headers differently.
+typedef enum {
+  BG3D_VARIANT_OTTOMATIC,
+  BG3D_VARIANT_BOOK,
+  BG3D_VARIANT_UNKNOWN
+} BG3DVariant;
+
+// On-disk layouts of the two variants. Every field is big endian.
+typedef struct {
+  uint32_t width, height;
+  uint32_t srcPixelFormat, dstPixelFormat;
+  uint32_t bufferSize;
+  uint32_t reserved[4];
+} BG3DOttoTextureHeader;
+
+typedef struct {
+  uint32_t width, height;
+  uint32_t bufferSize;
+} BG3DBookTextureHeader;
+
+typedef struct {
+  uint32_t type;
+  uint32_t numMaterials;
+  uint32_t layerMaterialNum[4];
+  uint32_t flags;
+  uint32_t numPoints;
+  uint32_t numTriangles;
+  uint32_t reserved[4];
+} BG3DOttoMeshHeader;
+
+typedef struct {
+  uint32_t materialNum;
+  uint32_t flags;
+  uint32_t numPoints;
+  uint32_t numTriangles;
+} BG3DBookMeshHeader;
+
+// The headers after decoding, the same for either variant. The pixel
+// formats are OpenGL enums, and are 0 for the book's files, which leave
+// them out.
 typedef struct {
   uint32_t width, height;
-#ifdef OTTOMATIC
-  uint32_t unknwn1, unknwn2;
-#endif // OTTOMATIC
+  uint32_t srcPixelFormat, dstPixelFormat;
   uint32_t bufferSize;
-#ifdef OTTOMATIC
-  char unknwn3[16];
-#endif // OTTOMATIC
 } BG3DTextureHeader;
 
 typedef struct {
   uint32_t materialNum;
   uint32_t flags;
-#ifdef OTTOMATIC
-  char unknwn1[20];
-#endif // OTTOMATIC
   uint32_t numPoints;
   uint32_t numTriangles;
-#ifdef OTTOMATIC
-  char unknwn2[16];
-#endif // OTTOMATIC
 } BG3DMeshHeader;
 
+// An axis aligned box. An empty one has min above max, at infinity.
+typedef struct {
+  float min[3];
+  float max[3];
+} BG3DBounds;
+
+typedef struct {
+  uint32_t flags;
+  float diffuseColor[4];
+  int32_t textureNum;
+} BG3DMaterial;
+
+// The pixels are a view into the reader, so they are only valid while the
+// file stays open. Pixels read from a stream are copied into the model.
+typedef struct {
+  BG3DTextureHeader header;
+  const uint8_t * pixels;
+} BG3DTexture;
+
+// The bounds of a group take in everything inside it, subgroups included.
+typedef struct {
+  int32_t parent;
+  BG3DBounds bounds;
+} BG3DGroup;
+
+// A mesh with its arrays decoded into native order. The colors are RGBA
+// bytes, which need no decoding and so are the file's own on a mapped file,
+// and the triangles are three indices each. The bounds are worked
+// out as the points are decoded, so they stay empty in metadata mode.
+typedef struct {
+  BG3DMeshHeader header;
+  int32_t group;
+  BG3DBounds bounds;
+  float * points;
+  float * normals;
+  float * uvs;
+  const uint8_t * colors;
+  uint32_t * triangles;
+} BG3DMesh;
+
+// Everything parsed out of one file. Groups and meshes refer to their
+// parents, materials to their textures, by index; -1 means none. All of
+// it lives in the model's arena. The bounds cover every mesh in the file.
+typedef struct {
+  BG3DArena arena;
+  BG3DHeaderType header;
+  BG3DVariant variant;
+  BG3DBounds bounds;
+
+  BG3DMaterial * materials;
+  uint32_t numMaterials;
+
+  BG3DTexture * textures;
+  uint32_t numTextures;
+
+  BG3DGroup * groups;
+  uint32_t numGroups;
+
+  BG3DMesh * meshes;
+  uint32_t numMeshes;
+
+  int32_t currentGroup;
+} BG3DModel;
+
 enum {
   BG3D_TAGTYPE_MATERIALFLAGS		=	0,
   BG3D_TAGTYPE_MATERIALDIFFUSECOLOR	=	1,
@@ -57,21 +198,94 @@ enum {
   BG3D_TAGTYPE_ENDFILE			=	11
 };
 
-void readHeader (FILE *);
-void parseFile (FILE *);
+// What the flags of a material mean to the game.
+enum {
+  BG3D_MATERIALFLAG_TEXTURED		=	1 << 0,
+  BG3D_MATERIALFLAG_ALWAYSBLEND		=	1 << 1,
+  BG3D_MATERIALFLAG_CLAMP_U		=	1 << 2,
+  BG3D_MATERIALFLAG_CLAMP_V		=	1 << 3
+};
+
+// One record of the tag stream. The offset is that of the tag itself, the
+// payload starts 4 bytes later and is length bytes long.
+typedef struct {
+  long offset;
+  uint32_t tag;
+  uint32_t length;
+  uint32_t index;
+} BG3DTocEntry;
+
+// The records in file order, and for looking them up by tag, the position
+// of each tag's nth record in byTag[tagStarts[tag] + n].
+typedef struct {
+  BG3DVariant variant;
+  BG3DTocEntry * entries;
+  size_t count;
+  size_t capacity;
+  uint32_t tagCounts[BG3D_TAGTYPE_ENDFILE + 1];
+  size_t tagStarts[BG3D_TAGTYPE_ENDFILE + 1];
+  size_t * byTag;
+} BG3DToc;
+
+// How textures are fitted into BC1 and BC3 blocks, if they are at all.
+typedef enum {
+  BG3D_BLOCKS_NONE,
+  BG3D_BLOCKS_RANGE_FIT,
+  BG3D_BLOCKS_CLUSTER_FIT
+} BG3DBlockCompression;
+
+// Choices for the exporters. Zeroed options write the model as it is, with
+// its textures as uncompressed PNGs. The texture level runs from 0 to 9.
+// Mipmapped or block compressed textures are written as KTX2 files instead,
+// which the level has no effect on.
+typedef struct {
+  bool quantize;
+  bool compress;
+  int textureLevel;
+  bool mipmaps;
+  BG3DBlockCompression blocks;
+} BG3DExportOptions;
+
+// The library is built with hidden visibility, so only what's marked here
+// is exported from the shared object.
+#define BG3D_API __attribute__((visibility("default")))
+
+// reader.c
+BG3D_API BG3DError openReader (BG3DReader *, const char *);
+BG3D_API BG3DError openStreamReader (BG3DReader *, int, bool);
+BG3D_API void closeReader (BG3DReader *);
+BG3D_API const char * errorString (BG3DError);
+BG3D_API void setMetadataOnly (BG3DReader *);
+
+// model.c
+BG3D_API void initModel (BG3DModel *);
+BG3D_API void resetModel (BG3DModel *);
+BG3D_API void freeModel (BG3DModel *);
+BG3D_API BG3DError mergeMaterials (BG3DModel *);
+
+// bg3d.c
+BG3D_API extern const char * variantNames[];
+
+BG3D_API BG3DVariant detectVariant (BG3DReader *);
+BG3D_API BG3DError readHeader (BG3DReader *, BG3DModel *);
+BG3D_API BG3DError parseFile (BG3DReader *, BG3DModel *);
+
+// toc.c
+BG3D_API extern const char * tagNames[];
 
-void readMaterialFlags (FILE *);
-void readMaterialDiffuseColor (FILE *);
-void readMaterialTextureMap (FILE *);
-void readGroup (void);
-void endGroup (void);
+BG3D_API BG3DError buildToc (BG3DReader *, BG3DToc *);
+BG3D_API void freeToc (BG3DToc *);
+BG3D_API const BG3DTocEntry * findTag (const BG3DToc *, uint32_t, uint32_t);
+BG3D_API bool seekToTag (BG3DReader *, const BG3DTocEntry *);
+BG3D_API BG3DError parseTextureAt (BG3DReader *, const BG3DToc *, BG3DModel *, uint32_t);
+BG3D_API BG3DError parseMeshAt (BG3DReader *, const BG3DToc *, BG3DModel *, uint32_t);
+BG3D_API void printToc (const BG3DToc *, FILE *);
 
-BG3DMeshHeader * readNewMesh (FILE *);
-void readVertexArray (FILE *, BG3DMeshHeader *);
-void readNormalArray (FILE *, BG3DMeshHeader *);
-void readUVArray (FILE *, BG3DMeshHeader *);
-void readVertexColorArray (FILE *, BG3DMeshHeader *);
-void readTriangleArray (FILE *, BG3DMeshHeader *);
+// weld.c
+BG3D_API BG3DError weldModel (BG3DModel *);
 
-void preLoadTextureMaterials (void);
+// gltf.c
+BG3D_API BG3DError exportGLTF (const BG3DModel *, const char *, const BG3DExportOptions *);
+BG3D_API BG3DError exportGLB (const BG3DModel *, const char *, const BG3DExportOptions *);
 
+#endif /* BG3D_H */
@@ -1,9 +0,0 @@
-#ifndef COMMON_H
-#define COMMON_H
-
-void die() {
-  printf("Something went wrong.\n");
-  exit(1);
-}
-
-#endif /* COMMON_H */
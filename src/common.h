@@ -0,0 +1,76 @@
+#ifndef COMMON_H
+#define COMMON_H
+
+#include "bg3d.h"
+
+// Helpers shared by the library sources but not part of its interface.
+
+BG3DError setError (BG3DReader *, BG3DError, const char *);
+
+BG3DMaterial * addMaterial (BG3DModel *);
+BG3DTexture * addTexture (BG3DModel *);
+BG3DGroup * addGroup (BG3DModel *);
+BG3DMesh * addMesh (BG3DModel *);
+
+// reader.c
+size_t peekBytes (BG3DReader *, size_t);
+const void * readBytes (BG3DReader *, size_t);
+void * readPayload (BG3DReader *, BG3DArena *, size_t);
+bool seekReader (BG3DReader *, size_t);
+bool skipBytes (BG3DReader *, size_t);
+bool readU32 (BG3DReader *, uint32_t *);
+
+// arena.c
+void initArena (BG3DArena *);
+void * arenaAlloc (BG3DArena *, size_t);
+void * arenaGrow (BG3DArena *, void *, size_t, size_t);
+void resetArena (BG3DArena *);
+void freeArena (BG3DArena *);
+
+// model.c
+void initBounds (BG3DBounds *);
+void mergeBounds (BG3DBounds *, const BG3DBounds *);
+
+// bg3d.c
+BG3DError readMaterialFlags (BG3DReader *, BG3DModel *);
+BG3DError readMaterialDiffuseColor (BG3DReader *, BG3DModel *);
+BG3DError readMaterialTextureMap (BG3DReader *, BG3DModel *);
+BG3DError readGroup (BG3DReader *, BG3DModel *);
+BG3DError endGroup (BG3DReader *, BG3DModel *);
+
+BG3DError readNewMesh (BG3DReader *, BG3DModel *);
+BG3DError readVertexArray (BG3DReader *, BG3DModel *);
+BG3DError readNormalArray (BG3DReader *, BG3DModel *);
+BG3DError readUVArray (BG3DReader *, BG3DModel *);
+BG3DError readVertexColorArray (BG3DReader *, BG3DModel *);
+BG3DError readTriangleArray (BG3DReader *, BG3DModel *);
+
+// decode.c
+void decodeBigEndian32 (void *, const void *, size_t);
+void decodePoints (void *, const void *, size_t, BG3DBounds *);
+
+// encode.c
+void narrowIndices16 (uint16_t *, const uint32_t *, size_t);
+void narrowIndices8 (uint8_t *, const uint32_t *, size_t);
+void quantizePoints (int16_t *, const float *, size_t, const float *, float);
+void quantizeNormals (int8_t *, const float *, size_t);
+void quantizeUVs (uint16_t *, const float *, size_t);
+void swizzlePixels (uint8_t *, const uint8_t *, size_t, const uint8_t *);
+void expandPixels (uint8_t *, const uint8_t *, size_t, const uint8_t *);
+
+// meshopt.c
+size_t vertexStreamBound (size_t, size_t);
+size_t encodeVertexStream (uint8_t *, const void *, size_t, size_t);
+size_t indexStreamBound (size_t);
+size_t encodeIndexStream (uint8_t *, const uint32_t *, size_t);
+
+// png.c
+BG3DError encodePNG (const BG3DTexture *, BG3DVariant, int, uint8_t **, size_t *);
+
+// ktx.c
+BG3DError encodeKTX2 (const BG3DTexture *, BG3DVariant, bool, BG3DBlockCompression, int, uint8_t **, size_t *);
+
+// bc.c
+void compressBlocks (uint8_t *, const uint8_t *, uint32_t, uint32_t, bool, BG3DBlockCompression, int);
+
+#endif /* COMMON_H */
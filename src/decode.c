@@ -0,0 +1,204 @@
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DECODE_X86
+#endif
+
+#include "common.h"
+
+// Byte swap kernels for the big endian 32 bit arrays (floats and indices)
+// that make up most of a BG3D file. All of them take unaligned input, since
+// payloads are viewed straight out of the file, and may work in place.
+
+static void decodeBigEndian32Scalar (void * dst, const void * src, size_t count) {
+	const uint8_t * in = src;
+	uint8_t * out = dst;
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t value;
+		memcpy(&value, in + i * 4, 4);
+		value = be32toh(value);
+		memcpy(out + i * 4, &value, 4);
+	}
+}
+
+// Points are decoded a vertex at a time here, folding each one into the
+// bounds. Comparisons against NaN are false, so NaNs never widen them.
+static void decodePointsScalar (void * dst, const void * src, size_t numPoints, BG3DBounds * bounds) {
+	float * out = dst;
+
+	decodeBigEndian32Scalar(dst, src, numPoints * 3);
+
+	for (size_t i = 0; i < numPoints * 3; i += 3) {
+		for (int j = 0; j < 3; j++) {
+			float v = out[i + j];
+			bounds->min[j] = v < bounds->min[j] ? v : bounds->min[j];
+			bounds->max[j] = v > bounds->max[j] ? v : bounds->max[j];
+		}
+	}
+}
+
+// The vector kernels below keep one running min and max per register in
+// a block of vertices. A block of three registers starts on a vertex
+// boundary, so float k of it is always component k % 3, which is how the
+// lanes are folded back into the bounds at the end.
+static void foldLanes (const float * min, const float * max, size_t lanes, BG3DBounds * bounds) {
+	for (size_t k = 0; k < lanes; k++) {
+		int j = k % 3;
+		bounds->min[j] = min[k] < bounds->min[j] ? min[k] : bounds->min[j];
+		bounds->max[j] = max[k] > bounds->max[j] ? max[k] : bounds->max[j];
+	}
+}
+
+#ifdef DECODE_X86
+__attribute__((target("ssse3")))
+static void decodeBigEndian32SSSE3 (void * dst, const void * src, size_t count) {
+	const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	const uint8_t * in = src;
+	uint8_t * out = dst;
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (in + i * 4));
+		__m128i b = _mm_loadu_si128((const __m128i *) (in + i * 4 + 16));
+		_mm_storeu_si128((__m128i *) (out + i * 4), _mm_shuffle_epi8(a, mask));
+		_mm_storeu_si128((__m128i *) (out + i * 4 + 16), _mm_shuffle_epi8(b, mask));
+	}
+
+	decodeBigEndian32Scalar(out + i * 4, in + i * 4, count - i);
+}
+
+__attribute__((target("avx2")))
+static void decodeBigEndian32AVX2 (void * dst, const void * src, size_t count) {
+	const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+	                                      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	const uint8_t * in = src;
+	uint8_t * out = dst;
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (in + i * 4));
+		__m256i b = _mm256_loadu_si256((const __m256i *) (in + i * 4 + 32));
+		_mm256_storeu_si256((__m256i *) (out + i * 4), _mm256_shuffle_epi8(a, mask));
+		_mm256_storeu_si256((__m256i *) (out + i * 4 + 32), _mm256_shuffle_epi8(b, mask));
+	}
+
+	decodeBigEndian32Scalar(out + i * 4, in + i * 4, count - i);
+}
+
+// Four vertices per block of three registers. The running values come
+// second in min and max, so a NaN in the data leaves them alone.
+__attribute__((target("ssse3")))
+static void decodePointsSSSE3 (void * dst, const void * src, size_t numPoints, BG3DBounds * bounds) {
+	const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	const uint8_t * in = src;
+	uint8_t * out = dst;
+	size_t i = 0;
+
+	__m128 min[3], max[3];
+
+	for (int r = 0; r < 3; r++) {
+		min[r] = _mm_set1_ps(__builtin_inff());
+		max[r] = _mm_set1_ps(-__builtin_inff());
+	}
+
+	for (; i + 4 <= numPoints; i += 4) {
+		for (int r = 0; r < 3; r++) {
+			__m128i raw = _mm_loadu_si128((const __m128i *) (in + i * 12 + r * 16));
+			__m128 v = _mm_castsi128_ps(_mm_shuffle_epi8(raw, mask));
+
+			_mm_storeu_ps((float *) (out + i * 12 + r * 16), v);
+			min[r] = _mm_min_ps(v, min[r]);
+			max[r] = _mm_max_ps(v, max[r]);
+		}
+	}
+
+	float lanesMin[12], lanesMax[12];
+
+	for (int r = 0; r < 3; r++) {
+		_mm_storeu_ps(lanesMin + r * 4, min[r]);
+		_mm_storeu_ps(lanesMax + r * 4, max[r]);
+	}
+
+	foldLanes(lanesMin, lanesMax, 12, bounds);
+	decodePointsScalar(out + i * 12, in + i * 12, numPoints - i, bounds);
+}
+
+// Eight vertices per block of three registers.
+__attribute__((target("avx2")))
+static void decodePointsAVX2 (void * dst, const void * src, size_t numPoints, BG3DBounds * bounds) {
+	const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+	                                      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	const uint8_t * in = src;
+	uint8_t * out = dst;
+	size_t i = 0;
+
+	__m256 min[3], max[3];
+
+	for (int r = 0; r < 3; r++) {
+		min[r] = _mm256_set1_ps(__builtin_inff());
+		max[r] = _mm256_set1_ps(-__builtin_inff());
+	}
+
+	for (; i + 8 <= numPoints; i += 8) {
+		for (int r = 0; r < 3; r++) {
+			__m256i raw = _mm256_loadu_si256((const __m256i *) (in + i * 12 + r * 32));
+			__m256 v = _mm256_castsi256_ps(_mm256_shuffle_epi8(raw, mask));
+
+			_mm256_storeu_ps((float *) (out + i * 12 + r * 32), v);
+			min[r] = _mm256_min_ps(v, min[r]);
+			max[r] = _mm256_max_ps(v, max[r]);
+		}
+	}
+
+	float lanesMin[24], lanesMax[24];
+
+	for (int r = 0; r < 3; r++) {
+		_mm256_storeu_ps(lanesMin + r * 8, min[r]);
+		_mm256_storeu_ps(lanesMax + r * 8, max[r]);
+	}
+
+	foldLanes(lanesMin, lanesMax, 24, bounds);
+	decodePointsScalar(out + i * 12, in + i * 12, numPoints - i, bounds);
+}
+#endif // DECODE_X86
+
+static void (*decodeBigEndian32Kernel) (void *, const void *, size_t);
+static void (*decodePointsKernel) (void *, const void *, size_t, BG3DBounds *);
+
+// Library callers may decode on several threads at once, so the kernels are
+// picked exactly once, before any of them reads a pointer.
+static pthread_once_t decodeKernelsOnce = PTHREAD_ONCE_INIT;
+
+// Picks the widest kernels the CPU supports the first time one is needed.
+static void selectDecodeKernels () {
+	decodeBigEndian32Kernel = decodeBigEndian32Scalar;
+	decodePointsKernel = decodePointsScalar;
+
+#ifdef DECODE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		decodeBigEndian32Kernel = decodeBigEndian32AVX2;
+		decodePointsKernel = decodePointsAVX2;
+	} else if (__builtin_cpu_supports("ssse3")) {
+		decodeBigEndian32Kernel = decodeBigEndian32SSSE3;
+		decodePointsKernel = decodePointsSSSE3;
+	}
+#endif // DECODE_X86
+}
+
+// Converts count big endian 32 bit values into native order.
+void decodeBigEndian32 (void * dst, const void * src, size_t count) {
+	pthread_once(&decodeKernelsOnce, selectDecodeKernels);
+	decodeBigEndian32Kernel(dst, src, count);
+}
+
+// Converts numPoints big endian vertices into native floats, widening the
+// bounds to take them in on the way.
+void decodePoints (void * dst, const void * src, size_t numPoints, BG3DBounds * bounds) {
+	pthread_once(&decodeKernelsOnce, selectDecodeKernels);
+	decodePointsKernel(dst, src, numPoints, bounds);
+}
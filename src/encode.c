@@ -0,0 +1,279 @@
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ENCODE_X86
+#endif
+
+#include "common.h"
+
+// Kernels for the export side: packing the model's arrays into the
+// narrower types glTF can take, and textures into the channel orders image
+// files want. Every one has to give the same results whichever instruction
+// set runs it.
+
+// Indices are only narrowed when they all fit, so the saturating packs
+// below never actually saturate.
+static void narrowIndices16Scalar (uint16_t * dst, const uint32_t * src, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		dst[i] = src[i];
+	}
+}
+
+static void narrowIndices8Scalar (uint8_t * dst, const uint32_t * src, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		dst[i] = src[i];
+	}
+}
+
+// Texture pixels are reordered into another channel order by giving, for
+// each byte of the output pixel, the byte of the input pixel it comes from.
+static void swizzlePixelsScalar (uint8_t * dst, const uint8_t * src, size_t count, const uint8_t * order) {
+	for (size_t i = 0; i < count; i++, src += 4, dst += 4) {
+		uint8_t pixel[4] = { src[order[0]], src[order[1]], src[order[2]], src[order[3]] };
+		memcpy(dst, pixel, 4);
+	}
+}
+
+// Three byte pixels are widened to four the same way, with opaque alpha.
+static void expandPixelsScalar (uint8_t * dst, const uint8_t * src, size_t count, const uint8_t * order) {
+	for (size_t i = 0; i < count; i++, src += 3, dst += 4) {
+		uint8_t pixel[4] = { src[order[0]], src[order[1]], src[order[2]], 0xff };
+		memcpy(dst, pixel, 4);
+	}
+}
+
+#ifdef ENCODE_X86
+// The shuffle that does the reordering for four pixels at a time, spaced
+// size bytes apart in the input. Bytes past the end of the order are
+// zeroed.
+static void pixelShuffle (uint8_t * mask, const uint8_t * order, int size) {
+	for (int i = 0; i < 4; i++) {
+		for (int k = 0; k < 4; k++) {
+			mask[i * 4 + k] = k < size ? i * size + order[k] : 0x80;
+		}
+	}
+}
+
+__attribute__((target("ssse3")))
+static void swizzlePixelsSSSE3 (uint8_t * dst, const uint8_t * src, size_t count, const uint8_t * order) {
+	uint8_t mask[16];
+	pixelShuffle(mask, order, 4);
+
+	__m128i shuffle = _mm_loadu_si128((const __m128i *) mask);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i *) (src + i * 4));
+		_mm_storeu_si128((__m128i *) (dst + i * 4), _mm_shuffle_epi8(pixels, shuffle));
+	}
+
+	swizzlePixelsScalar(dst + i * 4, src + i * 4, count - i, order);
+}
+
+// Each load takes 16 bytes for the 12 it uses, so the last pixels are left
+// to the scalar loop rather than read past the end.
+__attribute__((target("ssse3")))
+static void expandPixelsSSSE3 (uint8_t * dst, const uint8_t * src, size_t count, const uint8_t * order) {
+	uint8_t mask[16];
+	pixelShuffle(mask, order, 3);
+
+	__m128i shuffle = _mm_loadu_si128((const __m128i *) mask);
+	__m128i alpha = _mm_set1_epi32((int) 0xff000000);
+	size_t i = 0;
+
+	for (; i + 6 <= count; i += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i *) (src + i * 3));
+		__m128i expanded = _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha);
+		_mm_storeu_si128((__m128i *) (dst + i * 4), expanded);
+	}
+
+	expandPixelsScalar(dst + i * 4, src + i * 3, count - i, order);
+}
+
+__attribute__((target("sse4.1")))
+static void narrowIndices16SSE41 (uint16_t * dst, const uint32_t * src, size_t count) {
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i b = _mm_loadu_si128((const __m128i *) (src + i + 4));
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi32(a, b));
+	}
+
+	narrowIndices16Scalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("sse4.1")))
+static void narrowIndices8SSE41 (uint8_t * dst, const uint32_t * src, size_t count) {
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i b = _mm_loadu_si128((const __m128i *) (src + i + 4));
+		__m128i c = _mm_loadu_si128((const __m128i *) (src + i + 8));
+		__m128i d = _mm_loadu_si128((const __m128i *) (src + i + 12));
+		__m128i ab = _mm_packus_epi32(a, b);
+		__m128i cd = _mm_packus_epi32(c, d);
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(ab, cd));
+	}
+
+	narrowIndices8Scalar(dst + i, src + i, count - i);
+}
+
+// The AVX2 packs work within each 128 bit lane, so the results come out
+// interleaved by lane and are put back in order with a permute.
+__attribute__((target("avx2")))
+static void narrowIndices16AVX2 (uint16_t * dst, const uint32_t * src, size_t count) {
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (src + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *) (src + i + 8));
+		__m256i packed = _mm256_packus_epi32(a, b);
+		_mm256_storeu_si256((__m256i *) (dst + i), _mm256_permute4x64_epi64(packed, 0xd8));
+	}
+
+	narrowIndices16Scalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void narrowIndices8AVX2 (uint8_t * dst, const uint32_t * src, size_t count) {
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	size_t i = 0;
+
+	for (; i + 32 <= count; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (src + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *) (src + i + 8));
+		__m256i c = _mm256_loadu_si256((const __m256i *) (src + i + 16));
+		__m256i d = _mm256_loadu_si256((const __m256i *) (src + i + 24));
+		__m256i ab = _mm256_packus_epi32(a, b);
+		__m256i cd = _mm256_packus_epi32(c, d);
+		__m256i packed = _mm256_packus_epi16(ab, cd);
+		_mm256_storeu_si256((__m256i *) (dst + i), _mm256_permutevar8x32_epi32(packed, order));
+	}
+
+	narrowIndices8Scalar(dst + i, src + i, count - i);
+}
+
+// Pixels never straddle the 128 bit lanes, so the same shuffle does for both.
+__attribute__((target("avx2")))
+static void swizzlePixelsAVX2 (uint8_t * dst, const uint8_t * src, size_t count, const uint8_t * order) {
+	uint8_t mask[16];
+	pixelShuffle(mask, order, 4);
+
+	__m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) mask));
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i pixels = _mm256_loadu_si256((const __m256i *) (src + i * 4));
+		_mm256_storeu_si256((__m256i *) (dst + i * 4), _mm256_shuffle_epi8(pixels, shuffle));
+	}
+
+	swizzlePixelsScalar(dst + i * 4, src + i * 4, count - i, order);
+}
+#endif // ENCODE_X86
+
+static void (*narrowIndices16Kernel) (uint16_t *, const uint32_t *, size_t);
+static void (*narrowIndices8Kernel) (uint8_t *, const uint32_t *, size_t);
+static void (*swizzlePixelsKernel) (uint8_t *, const uint8_t *, size_t, const uint8_t *);
+static void (*expandPixelsKernel) (uint8_t *, const uint8_t *, size_t, const uint8_t *);
+
+// Textures are encoded on several threads at once, so the kernels are
+// picked exactly once, before any of them reads a pointer.
+static pthread_once_t encodeKernelsOnce = PTHREAD_ONCE_INIT;
+
+// Picks the widest kernels the CPU supports the first time one is needed.
+static void selectEncodeKernels () {
+	narrowIndices16Kernel = narrowIndices16Scalar;
+	narrowIndices8Kernel = narrowIndices8Scalar;
+	swizzlePixelsKernel = swizzlePixelsScalar;
+	expandPixelsKernel = expandPixelsScalar;
+
+#ifdef ENCODE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("ssse3")) {
+		swizzlePixelsKernel = swizzlePixelsSSSE3;
+		expandPixelsKernel = expandPixelsSSSE3;
+	}
+
+	if (__builtin_cpu_supports("avx2")) {
+		narrowIndices16Kernel = narrowIndices16AVX2;
+		narrowIndices8Kernel = narrowIndices8AVX2;
+		swizzlePixelsKernel = swizzlePixelsAVX2;
+	} else if (__builtin_cpu_supports("sse4.1")) {
+		narrowIndices16Kernel = narrowIndices16SSE41;
+		narrowIndices8Kernel = narrowIndices8SSE41;
+	}
+#endif // ENCODE_X86
+}
+
+// Copies count indices into 16 bits each. They must all be below 65536.
+void narrowIndices16 (uint16_t * dst, const uint32_t * src, size_t count) {
+	pthread_once(&encodeKernelsOnce, selectEncodeKernels);
+	narrowIndices16Kernel(dst, src, count);
+}
+
+// Copies count indices into 8 bits each. They must all be below 256.
+void narrowIndices8 (uint8_t * dst, const uint32_t * src, size_t count) {
+	pthread_once(&encodeKernelsOnce, selectEncodeKernels);
+	narrowIndices8Kernel(dst, src, count);
+}
+
+// Reorders the channels of count four byte pixels: byte k of each output
+// pixel is byte order[k] of the input one. The two may be the same buffer.
+void swizzlePixels (uint8_t * dst, const uint8_t * src, size_t count, const uint8_t * order) {
+	pthread_once(&encodeKernelsOnce, selectEncodeKernels);
+	swizzlePixelsKernel(dst, src, count, order);
+}
+
+// Widens count three byte pixels to four, taking byte k of each from byte
+// order[k] of the input, with opaque alpha last.
+void expandPixels (uint8_t * dst, const uint8_t * src, size_t count, const uint8_t * order) {
+	pthread_once(&encodeKernelsOnce, selectEncodeKernels);
+	expandPixelsKernel(dst, src, count, order);
+}
+
+// Rounds a value in [-1, 1] to the nearest of the given number of steps
+// either side of zero. Anything outside the range, NaN included, is
+// clamped into it.
+static int32_t quantizeSnorm (float v, float steps) {
+	v = fminf(fmaxf(v, -1.0f), 1.0f);
+	return (int32_t) lrintf(v * steps);
+}
+
+// Quantizes points into normalized shorts, within a cube scale across
+// either way of the offset. Each point is padded out to four shorts, since
+// glTF wants every vertex attribute aligned to 4 bytes.
+void quantizePoints (int16_t * dst, const float * src, size_t numPoints, const float * offset, float scale) {
+	float inverse = 1.0f / scale;
+
+	for (size_t i = 0; i < numPoints; i++, src += 3, dst += 4) {
+		for (int j = 0; j < 3; j++) {
+			dst[j] = quantizeSnorm((src[j] - offset[j]) * inverse, 32767.0f);
+		}
+
+		dst[3] = 0;
+	}
+}
+
+// Quantizes unit normals into normalized bytes, padded to four like points.
+void quantizeNormals (int8_t * dst, const float * src, size_t numPoints) {
+	for (size_t i = 0; i < numPoints; i++, src += 3, dst += 4) {
+		for (int j = 0; j < 3; j++) {
+			dst[j] = quantizeSnorm(src[j], 127.0f);
+		}
+
+		dst[3] = 0;
+	}
+}
+
+// Quantizes texture coordinates in [0, 1] into normalized unsigned shorts.
+void quantizeUVs (uint16_t * dst, const float * src, size_t numPoints) {
+	for (size_t i = 0; i < numPoints * 2; i++) {
+		dst[i] = lrintf(fminf(fmaxf(src[i], 0.0f), 1.0f) * 65535.0f);
+	}
+}
@@ -0,0 +1,1350 @@
+#include <errno.h>
+#include <math.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "common.h"
+#include "json.h"
+
+// glTF enums
+#define GLTF_ARRAY_BUFFER 34962
+#define GLTF_ELEMENT_ARRAY_BUFFER 34963
+#define GLTF_BYTE 5120
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_SHORT 5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+#define GLTF_TRIANGLES 4
+#define GLTF_LINEAR 9729
+#define GLTF_LINEAR_MIPMAP_LINEAR 9987
+#define GLTF_CLAMP_TO_EDGE 33071
+#define GLTF_REPEAT 10497
+
+// GLB chunk types and padding
+#define GLB_MAGIC 0x46546C67
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+#define GLB_PADDING(length) ((4 - ((length) & 3)) & 3)
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#define PATH_LENGTH 4096
+
+// Meshes have at most this many arrays.
+#define ARRAYS_PER_MESH 5
+
+// The most threads textures are encoded on at once.
+#define MAX_IMAGE_THREADS 16
+
+// How an array gets from the model into the buffer.
+typedef enum {
+	GLTF_AS_IS,
+	GLTF_INDICES16,
+	GLTF_INDICES8,
+	GLTF_POINTS16,
+	GLTF_NORMALS8,
+	GLTF_UVS16
+} GLTFEncoding;
+
+// One of a mesh's arrays, as it goes into the binary buffer, with the
+// accessor describing it. The attribute is NULL for the indices. Arrays
+// that aren't written as is are encoded into a scratch buffer first. Every
+// array takes up a multiple of 4 bytes of the buffer, so the next one
+// stays aligned; a stride is only given for padded vertices.
+typedef struct {
+	const char * attribute;
+	const void * data;
+	size_t length;
+	int target;
+	int componentType;
+	uint32_t count;
+	const char * type;
+	bool normalized;
+	GLTFEncoding encoding;
+	uint32_t stride;
+} GLTFArray;
+
+// The bytes an array takes up in the buffer.
+#define GLTF_PADDED(length) (((length) + 3) & ~(size_t) 3)
+#define GLTF_ARRAY_SIZE(array) GLTF_PADDED((array)->length)
+
+// The bytes of each element of an array, which are what meshopt encodes.
+#define GLTF_ELEMENT_SIZE(array) ((array)->length / (array)->count)
+
+// The binary buffer as a list of vectors, with room left before it for the
+// file's headers and after it for padding. Compressed buffers are written
+// as meshopt streams, whose exact lengths are kept, or 0 for arrays that
+// didn't shrink and went in as they were; the arrays as they would be laid
+// out uncompressed make up the fallback buffer. The textures are encoded
+// either way, as imageType files; embedded, they follow the arrays, each
+// padded by a vector of its own.
+typedef struct {
+	struct iovec * vectors;
+	size_t numVectors;
+	size_t numArrays;
+	size_t byteLength;
+	size_t fallbackLength;
+	size_t * streamLengths;
+	uint8_t * scratch;
+	uint8_t ** images;
+	size_t * imageLengths;
+	uint32_t numImages;
+	bool imagesEmbedded;
+	const char * imageType;
+} GLTFBuffer;
+
+// Texture files are named after the model, the first plainly and the rest
+// numbered, with type as their extension.
+static void texturePath (char * path, size_t size, const char * name, uint32_t i, const char * type) {
+	if (i == 0) {
+		snprintf(path, size, "%s.%s", name, type);
+	} else {
+		snprintf(path, size, "%s_%u.%s", name, i, type);
+	}
+}
+
+// Quantized points are stored relative to the center of the mesh's bounds,
+// scaled by half their widest side so the cube fits in [-1, 1]. Using one
+// scale for every axis keeps the normals right without renormalizing.
+// Meshes without usable bounds keep their coordinates.
+static void quantizeFrame (const BG3DMesh * mesh, float * offset, float * scale) {
+	const BG3DBounds * bounds = &mesh->bounds;
+
+	*scale = 0.0f;
+
+	for (int i = 0; i < 3; i++) {
+		offset[i] = (bounds->min[i] + bounds->max[i]) * 0.5f;
+		*scale = fmaxf(*scale, (bounds->max[i] - bounds->min[i]) * 0.5f);
+	}
+
+	if (!isfinite(*scale) || !isfinite(offset[0] + offset[1] + offset[2])) {
+		offset[0] = offset[1] = offset[2] = 0.0f;
+		*scale = 1.0f;
+	}
+
+	if (*scale == 0.0f) {
+		*scale = 1.0f;
+	}
+}
+
+// UVs can only be quantized when they don't tile, since glTF has no
+// normalized type that reaches past 1.
+static bool unitUVs (const BG3DMesh * mesh) {
+	const float * uvs = mesh->uvs;
+	bool inside = true;
+
+	for (size_t i = 0; i < (size_t) mesh->header.numPoints * 2; i++) {
+		inside &= uvs[i] >= 0.0f && uvs[i] <= 1.0f;
+	}
+
+	return inside;
+}
+
+// Lists the arrays a mesh puts in the buffer, in order, and returns how
+// many there are. Arrays the file left out are left out of the buffer too.
+// Every pass over the model goes through this, so the accessors, views and
+// buffer contents line up without any of them being stored.
+static size_t meshArrays (const BG3DMesh * mesh, const BG3DExportOptions * options, GLTFArray * arrays) {
+	const BG3DMeshHeader * header = &mesh->header;
+	uint32_t numPoints = header->numPoints;
+	size_t n = 0;
+
+	if (mesh->points != NULL && numPoints > 0) {
+		if (options->quantize) {
+			arrays[n++] = (GLTFArray) {
+				.attribute = "POSITION",
+				.data = mesh->points,
+				.length = (size_t) numPoints * 8,
+				.target = GLTF_ARRAY_BUFFER,
+				.componentType = GLTF_SHORT,
+				.count = numPoints,
+				.type = "VEC3",
+				.normalized = true,
+				.encoding = GLTF_POINTS16,
+				.stride = 8
+			};
+		} else {
+			arrays[n++] = (GLTFArray) {
+				.attribute = "POSITION",
+				.data = mesh->points,
+				.length = (size_t) numPoints * 12,
+				.target = GLTF_ARRAY_BUFFER,
+				.componentType = GLTF_FLOAT,
+				.count = numPoints,
+				.type = "VEC3"
+			};
+		}
+	}
+
+	if (mesh->normals != NULL && numPoints > 0) {
+		if (options->quantize) {
+			arrays[n++] = (GLTFArray) {
+				.attribute = "NORMAL",
+				.data = mesh->normals,
+				.length = (size_t) numPoints * 4,
+				.target = GLTF_ARRAY_BUFFER,
+				.componentType = GLTF_BYTE,
+				.count = numPoints,
+				.type = "VEC3",
+				.normalized = true,
+				.encoding = GLTF_NORMALS8,
+				.stride = 4
+			};
+		} else {
+			arrays[n++] = (GLTFArray) {
+				.attribute = "NORMAL",
+				.data = mesh->normals,
+				.length = (size_t) numPoints * 12,
+				.target = GLTF_ARRAY_BUFFER,
+				.componentType = GLTF_FLOAT,
+				.count = numPoints,
+				.type = "VEC3"
+			};
+		}
+	}
+
+	// BG3D and glTF both put the origin of texture space at the first pixel
+	// of the image, so the UVs need no flipping
+	if (mesh->uvs != NULL && numPoints > 0) {
+		if (options->quantize && unitUVs(mesh)) {
+			arrays[n++] = (GLTFArray) {
+				.attribute = "TEXCOORD_0",
+				.data = mesh->uvs,
+				.length = (size_t) numPoints * 4,
+				.target = GLTF_ARRAY_BUFFER,
+				.componentType = GLTF_UNSIGNED_SHORT,
+				.count = numPoints,
+				.type = "VEC2",
+				.normalized = true,
+				.encoding = GLTF_UVS16
+			};
+		} else {
+			arrays[n++] = (GLTFArray) {
+				.attribute = "TEXCOORD_0",
+				.data = mesh->uvs,
+				.length = (size_t) numPoints * 8,
+				.target = GLTF_ARRAY_BUFFER,
+				.componentType = GLTF_FLOAT,
+				.count = numPoints,
+				.type = "VEC2"
+			};
+		}
+	}
+
+	if (mesh->colors != NULL && numPoints > 0) {
+		arrays[n++] = (GLTFArray) {
+			.attribute = "COLOR_0",
+			.data = mesh->colors,
+			.length = (size_t) numPoints * 4,
+			.target = GLTF_ARRAY_BUFFER,
+			.componentType = GLTF_UNSIGNED_BYTE,
+			.count = numPoints,
+			.type = "VEC4",
+			.normalized = true
+		};
+	}
+
+	// indices take the narrowest type that can reach every point, short of
+	// the all ones value glTF keeps for primitive restart
+	if (mesh->triangles != NULL && header->numTriangles > 0) {
+		uint32_t count = header->numTriangles * 3;
+
+		// meshopt only takes indices of 16 or 32 bits
+		if (numPoints < 256 && !options->compress) {
+			arrays[n++] = (GLTFArray) {
+				.data = mesh->triangles,
+				.length = count,
+				.target = GLTF_ELEMENT_ARRAY_BUFFER,
+				.componentType = GLTF_UNSIGNED_BYTE,
+				.count = count,
+				.type = "SCALAR",
+				.encoding = GLTF_INDICES8
+			};
+		} else if (numPoints < 65536) {
+			arrays[n++] = (GLTFArray) {
+				.data = mesh->triangles,
+				.length = (size_t) count * 2,
+				.target = GLTF_ELEMENT_ARRAY_BUFFER,
+				.componentType = GLTF_UNSIGNED_SHORT,
+				.count = count,
+				.type = "SCALAR",
+				.encoding = GLTF_INDICES16
+			};
+		} else {
+			arrays[n++] = (GLTFArray) {
+				.data = mesh->triangles,
+				.length = (size_t) count * 4,
+				.target = GLTF_ELEMENT_ARRAY_BUFFER,
+				.componentType = GLTF_UNSIGNED_INT,
+				.count = count,
+				.type = "SCALAR"
+			};
+		}
+	}
+
+	return n;
+}
+
+// Whether the array has to be encoded before it goes in the buffer. Narrow
+// indices are encoded even when compressing, since an array that doesn't
+// compress goes in as the accessor reads it; the index codec itself reads
+// the model's own indices.
+static bool encodedArray (const GLTFArray * array) {
+	return array->encoding != GLTF_AS_IS;
+}
+
+// The most room the array's meshopt stream can take.
+static size_t streamBound (const GLTFArray * array) {
+	if (array->target == GLTF_ELEMENT_ARRAY_BUFFER) {
+		return GLTF_PADDED(indexStreamBound(array->count));
+	}
+
+	return GLTF_PADDED(vertexStreamBound(array->count, GLTF_ELEMENT_SIZE(array)));
+}
+
+// The totals of the whole model's arrays, needed before any of it is
+// written: glTF leaves out empty arrays, and GLB needs the length up front.
+// Returns how many arrays there are, how long they are uncompressed, and
+// how much scratch space encoding them takes.
+static size_t countArrays (const BG3DModel * model, const BG3DExportOptions * options, size_t * byteLength, size_t * scratchLength) {
+	GLTFArray arrays[ARRAYS_PER_MESH];
+	size_t count = 0;
+
+	*byteLength = 0;
+	*scratchLength = 0;
+
+	for (uint32_t i = 0; i < model->numMeshes; i++) {
+		size_t n = meshArrays(&model->meshes[i], options, arrays);
+
+		for (size_t j = 0; j < n; j++) {
+			*byteLength += GLTF_ARRAY_SIZE(&arrays[j]);
+
+			if (encodedArray(&arrays[j])) {
+				*scratchLength += GLTF_ARRAY_SIZE(&arrays[j]);
+			}
+
+			if (options->compress) {
+				*scratchLength += streamBound(&arrays[j]);
+			}
+		}
+
+		count += n;
+	}
+
+	return count;
+}
+
+static void writeVec3 (JSONWriter * writer, const float * v) {
+	jsonBeginArray(writer);
+
+	for (int i = 0; i < 3; i++) {
+		jsonFloat(writer, v[i]);
+	}
+
+	jsonEndArray(writer);
+}
+
+// Quantizes the point the same way the mesh's points are, so bounds written
+// this way match the quantized points exactly.
+static void writeQuantizedVec3 (JSONWriter * writer, const BG3DMesh * mesh, const float * v) {
+	float offset[3], scale;
+	int16_t q[4];
+
+	quantizeFrame(mesh, offset, &scale);
+	quantizePoints(q, v, 1, offset, scale);
+
+	jsonBeginArray(writer);
+
+	for (int i = 0; i < 3; i++) {
+		jsonInt(writer, q[i]);
+	}
+
+	jsonEndArray(writer);
+}
+
+// Each mesh is a single primitive over its own accessors, which are
+// numbered in the order meshArrays lists them.
+static void writeMeshes (JSONWriter * writer, const BG3DModel * model, const BG3DExportOptions * options) {
+	GLTFArray arrays[ARRAYS_PER_MESH];
+	uint32_t accessor = 0;
+
+	jsonKey(writer, "meshes");
+	jsonBeginArray(writer);
+
+	for (uint32_t i = 0; i < model->numMeshes; i++) {
+		size_t n = meshArrays(&model->meshes[i], options, arrays);
+
+		jsonBeginObject(writer);
+		jsonKey(writer, "primitives");
+		jsonBeginArray(writer);
+		jsonBeginObject(writer);
+		jsonKey(writer, "attributes");
+		jsonBeginObject(writer);
+
+		for (size_t j = 0; j < n; j++) {
+			if (arrays[j].attribute != NULL) {
+				jsonKey(writer, arrays[j].attribute);
+				jsonInt(writer, accessor + j);
+			}
+		}
+
+		jsonEndObject(writer);
+
+		for (size_t j = 0; j < n; j++) {
+			if (arrays[j].attribute == NULL) {
+				jsonKey(writer, "indices");
+				jsonInt(writer, accessor + j);
+			}
+		}
+
+		if (model->meshes[i].header.materialNum < model->numMaterials) {
+			jsonKey(writer, "material");
+			jsonInt(writer, model->meshes[i].header.materialNum);
+		}
+
+		jsonKey(writer, "mode");
+		jsonInt(writer, GLTF_TRIANGLES);
+		jsonEndObject(writer);
+		jsonEndArray(writer);
+		jsonEndObject(writer);
+
+		accessor += n;
+	}
+
+	jsonEndArray(writer);
+}
+
+// Every array has its own view, so accessor n reads view n.
+static void writeAccessors (JSONWriter * writer, const BG3DModel * model, const BG3DExportOptions * options) {
+	GLTFArray arrays[ARRAYS_PER_MESH];
+	uint32_t view = 0;
+
+	jsonKey(writer, "accessors");
+	jsonBeginArray(writer);
+
+	for (uint32_t i = 0; i < model->numMeshes; i++) {
+		const BG3DMesh * mesh = &model->meshes[i];
+		size_t n = meshArrays(mesh, options, arrays);
+
+		for (size_t j = 0; j < n; j++, view++) {
+			jsonBeginObject(writer);
+			jsonKey(writer, "bufferView");
+			jsonInt(writer, view);
+			jsonKey(writer, "componentType");
+			jsonInt(writer, arrays[j].componentType);
+
+			if (arrays[j].normalized) {
+				jsonKey(writer, "normalized");
+				jsonBool(writer, true);
+			}
+
+			jsonKey(writer, "count");
+			jsonInt(writer, arrays[j].count);
+			jsonKey(writer, "type");
+			jsonString(writer, arrays[j].type);
+
+			// glTF requires the bounds of every position accessor, in the
+			// accessor's own type
+			if (arrays[j].encoding == GLTF_POINTS16) {
+				jsonKey(writer, "min");
+				writeQuantizedVec3(writer, mesh, mesh->bounds.min);
+				jsonKey(writer, "max");
+				writeQuantizedVec3(writer, mesh, mesh->bounds.max);
+			} else if (arrays[j].data == mesh->points) {
+				jsonKey(writer, "min");
+				writeVec3(writer, mesh->bounds.min);
+				jsonKey(writer, "max");
+				writeVec3(writer, mesh->bounds.max);
+			}
+
+			jsonEndObject(writer);
+		}
+	}
+
+	jsonEndArray(writer);
+}
+
+// The meshopt stream behind a view, in the buffer actually written.
+static void writeStream (JSONWriter * writer, const GLTFArray * array, size_t offset, size_t length) {
+	jsonKey(writer, "extensions");
+	jsonBeginObject(writer);
+	jsonKey(writer, "EXT_meshopt_compression");
+	jsonBeginObject(writer);
+	jsonKey(writer, "buffer");
+	jsonInt(writer, 0);
+	jsonKey(writer, "byteOffset");
+	jsonInt(writer, offset);
+	jsonKey(writer, "byteLength");
+	jsonInt(writer, length);
+	jsonKey(writer, "byteStride");
+	jsonInt(writer, GLTF_ELEMENT_SIZE(array));
+	jsonKey(writer, "count");
+	jsonInt(writer, array->count);
+	jsonKey(writer, "mode");
+	jsonString(writer, array->target == GLTF_ELEMENT_ARRAY_BUFFER ? "TRIANGLES" : "ATTRIBUTES");
+	jsonEndObject(writer);
+	jsonEndObject(writer);
+}
+
+// The views follow each other through the one buffer. Compressed, they lie
+// in the fallback buffer, and their streams follow each other through the
+// real one; arrays that weren't compressed are viewed there directly.
+static void writeBufferViews (JSONWriter * writer, const BG3DModel * model, const BG3DExportOptions * options, const GLTFBuffer * buffer) {
+	GLTFArray arrays[ARRAYS_PER_MESH];
+	size_t offset = 0, streamOffset = 0, k = 0;
+
+	jsonKey(writer, "bufferViews");
+	jsonBeginArray(writer);
+
+	for (uint32_t i = 0; i < model->numMeshes; i++) {
+		size_t n = meshArrays(&model->meshes[i], options, arrays);
+
+		for (size_t j = 0; j < n; j++, k++) {
+			bool compressed = options->compress && buffer->streamLengths[k] > 0;
+
+			jsonBeginObject(writer);
+			jsonKey(writer, "buffer");
+			jsonInt(writer, compressed ? 1 : 0);
+			jsonKey(writer, "byteOffset");
+			jsonInt(writer, options->compress && !compressed ? streamOffset : offset);
+			jsonKey(writer, "byteLength");
+			jsonInt(writer, arrays[j].length);
+
+			if (arrays[j].stride != 0) {
+				jsonKey(writer, "byteStride");
+				jsonInt(writer, arrays[j].stride);
+			}
+
+			jsonKey(writer, "target");
+			jsonInt(writer, arrays[j].target);
+
+			if (compressed) {
+				writeStream(writer, &arrays[j], streamOffset, buffer->streamLengths[k]);
+				streamOffset += GLTF_PADDED(buffer->streamLengths[k]);
+			} else {
+				streamOffset += GLTF_ARRAY_SIZE(&arrays[j]);
+			}
+
+			jsonEndObject(writer);
+
+			offset += GLTF_ARRAY_SIZE(&arrays[j]);
+		}
+	}
+
+	// images are never compressed, so they go straight in the real buffer
+	if (options->compress) {
+		offset = streamOffset;
+	}
+
+	for (uint32_t i = 0; buffer->imagesEmbedded && i < buffer->numImages; i++) {
+		jsonBeginObject(writer);
+		jsonKey(writer, "buffer");
+		jsonInt(writer, 0);
+		jsonKey(writer, "byteOffset");
+		jsonInt(writer, offset);
+		jsonKey(writer, "byteLength");
+		jsonInt(writer, buffer->imageLengths[i]);
+		jsonEndObject(writer);
+
+		offset += GLTF_PADDED(buffer->imageLengths[i]);
+	}
+
+	jsonEndArray(writer);
+}
+
+// Whether the material's texture made it into an image.
+static bool hasImage (const BG3DMaterial * material, const GLTFBuffer * buffer) {
+	return material->textureNum >= 0 && (uint32_t) material->textureNum < buffer->numImages;
+}
+
+// The sampler for each of the four ways the clamp flags can be set, in the
+// order they are first used, or -1 for ones no material uses. Returns how
+// many there are.
+static uint32_t samplerSlots (const BG3DModel * model, const GLTFBuffer * buffer, int32_t * slots) {
+	uint32_t numSamplers = 0;
+
+	for (int i = 0; i < 4; i++) {
+		slots[i] = -1;
+	}
+
+	for (uint32_t i = 0; i < model->numMaterials; i++) {
+		const BG3DMaterial * material = &model->materials[i];
+		uint32_t clamp = (material->flags / BG3D_MATERIALFLAG_CLAMP_U) & 3;
+
+		if (hasImage(material, buffer) && slots[clamp] < 0) {
+			slots[clamp] = numSamplers++;
+		}
+	}
+
+	return numSamplers;
+}
+
+// Every texture has its own image, viewed after the arrays if embedded,
+// or else in a file named after imageName. Each textured material gets a
+// texture of its own, pairing its image with the sampler its clamp flags
+// call for.
+static void writeTextures (JSONWriter * writer, const BG3DModel * model, const GLTFBuffer * buffer, const char * imageName) {
+	int32_t slots[4];
+	samplerSlots(model, buffer, slots);
+
+	char mimeType[16];
+	snprintf(mimeType, sizeof(mimeType), "image/%s", buffer->imageType);
+
+	jsonKey(writer, "images");
+	jsonBeginArray(writer);
+
+	for (uint32_t i = 0; i < buffer->numImages; i++) {
+		jsonBeginObject(writer);
+
+		if (buffer->imagesEmbedded) {
+			jsonKey(writer, "bufferView");
+			jsonInt(writer, buffer->numArrays + i);
+			jsonKey(writer, "mimeType");
+			jsonString(writer, mimeType);
+		} else {
+			char uri[PATH_LENGTH];
+			texturePath(uri, sizeof(uri), imageName, i, buffer->imageType);
+
+			jsonKey(writer, "uri");
+			jsonString(writer, uri);
+		}
+
+		jsonEndObject(writer);
+	}
+
+	jsonEndArray(writer);
+
+	jsonKey(writer, "samplers");
+	jsonBeginArray(writer);
+
+	for (int32_t slot = 0; slot < 4; slot++) {
+		for (uint32_t clamp = 0; clamp < 4; clamp++) {
+			if (slots[clamp] != slot) {
+				continue;
+			}
+
+			jsonBeginObject(writer);
+			jsonKey(writer, "magFilter");
+			jsonInt(writer, GLTF_LINEAR);
+			jsonKey(writer, "minFilter");
+			jsonInt(writer, GLTF_LINEAR_MIPMAP_LINEAR);
+			jsonKey(writer, "wrapS");
+			jsonInt(writer, (clamp & 1) ? GLTF_CLAMP_TO_EDGE : GLTF_REPEAT);
+			jsonKey(writer, "wrapT");
+			jsonInt(writer, (clamp & 2) ? GLTF_CLAMP_TO_EDGE : GLTF_REPEAT);
+			jsonEndObject(writer);
+		}
+	}
+
+	jsonEndArray(writer);
+
+	jsonKey(writer, "textures");
+	jsonBeginArray(writer);
+
+	for (uint32_t i = 0; i < model->numMaterials; i++) {
+		const BG3DMaterial * material = &model->materials[i];
+
+		if (!hasImage(material, buffer)) {
+			continue;
+		}
+
+		jsonBeginObject(writer);
+		jsonKey(writer, "sampler");
+		jsonInt(writer, slots[(material->flags / BG3D_MATERIALFLAG_CLAMP_U) & 3]);
+		jsonKey(writer, "source");
+		jsonInt(writer, material->textureNum);
+		jsonEndObject(writer);
+	}
+
+	jsonEndArray(writer);
+}
+
+// One material for each of the file's, which meshes refer to by number.
+// BG3D materials are lit the old fixed function way, so they become rough
+// dielectrics tinted by their diffuse color. Those with a texture point at
+// the glTF texture made for it, which are numbered in material order.
+static void writeMaterials (JSONWriter * writer, const BG3DModel * model, const GLTFBuffer * buffer) {
+	uint32_t numTextures = 0;
+
+	jsonKey(writer, "materials");
+	jsonBeginArray(writer);
+
+	for (uint32_t i = 0; i < model->numMaterials; i++) {
+		const BG3DMaterial * material = &model->materials[i];
+
+		jsonBeginObject(writer);
+		jsonKey(writer, "pbrMetallicRoughness");
+		jsonBeginObject(writer);
+		jsonKey(writer, "baseColorFactor");
+		jsonBeginArray(writer);
+
+		for (int j = 0; j < 4; j++) {
+			jsonFloat(writer, fminf(fmaxf(material->diffuseColor[j], 0.0f), 1.0f));
+		}
+
+		jsonEndArray(writer);
+
+		if (hasImage(material, buffer)) {
+			jsonKey(writer, "baseColorTexture");
+			jsonBeginObject(writer);
+			jsonKey(writer, "index");
+			jsonInt(writer, numTextures++);
+			jsonEndObject(writer);
+		}
+
+		jsonKey(writer, "metallicFactor");
+		jsonInt(writer, 0);
+		jsonEndObject(writer);
+
+		// the game blends these whatever their alpha, and anything not
+		// quite opaque besides
+		if ((material->flags & BG3D_MATERIALFLAG_ALWAYSBLEND) || material->diffuseColor[3] < 1.0f) {
+			jsonKey(writer, "alphaMode");
+			jsonString(writer, "BLEND");
+		}
+
+		jsonEndObject(writer);
+	}
+
+	jsonEndArray(writer);
+}
+
+// Writes a node for every group, with the groups and meshes inside it as
+// children, then one for every mesh. Whatever isn't in a group goes
+// straight into the scene. Returns false if there's no memory to sort the
+// children by parent.
+static bool writeNodes (JSONWriter * writer, const BG3DModel * model, const BG3DExportOptions * options) {
+	uint32_t numGroups = model->numGroups;
+	uint32_t numNodes = numGroups + model->numMeshes;
+
+	if (numNodes == 0) {
+		return true;
+	}
+
+	// the children of each group, and then the scene's roots, end to end;
+	// group i's run from first[i] up to first[i + 1]
+	uint32_t * first = calloc(numGroups + 2, sizeof(uint32_t));
+	uint32_t * children = malloc(numNodes * sizeof(uint32_t));
+
+	if (first == NULL || children == NULL) {
+		free(first);
+		free(children);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < numNodes; i++) {
+		int32_t parent = i < numGroups ? model->groups[i].parent : model->meshes[i - numGroups].group;
+		first[(parent < 0 ? numGroups : (uint32_t) parent) + 1]++;
+	}
+
+	for (uint32_t i = 0; i <= numGroups; i++) {
+		first[i + 1] += first[i];
+	}
+
+	// fill each run in node order, using the start of the next run as a cursor
+	for (uint32_t i = 0; i < numNodes; i++) {
+		int32_t parent = i < numGroups ? model->groups[i].parent : model->meshes[i - numGroups].group;
+		children[first[parent < 0 ? numGroups : (uint32_t) parent]++] = i;
+	}
+
+	// the cursors ended up at the start of the next run, so shift them back
+	memmove(first + 1, first, (numGroups + 1) * sizeof(uint32_t));
+	first[0] = 0;
+
+	jsonKey(writer, "scene");
+	jsonInt(writer, 0);
+
+	jsonKey(writer, "scenes");
+	jsonBeginArray(writer);
+	jsonBeginObject(writer);
+	jsonKey(writer, "nodes");
+	jsonBeginArray(writer);
+
+	for (uint32_t j = first[numGroups]; j < first[numGroups + 1]; j++) {
+		jsonInt(writer, children[j]);
+	}
+
+	jsonEndArray(writer);
+	jsonEndObject(writer);
+	jsonEndArray(writer);
+
+	jsonKey(writer, "nodes");
+	jsonBeginArray(writer);
+
+	for (uint32_t i = 0; i < numGroups; i++) {
+		jsonBeginObject(writer);
+
+		if (first[i + 1] > first[i]) {
+			jsonKey(writer, "children");
+			jsonBeginArray(writer);
+
+			for (uint32_t j = first[i]; j < first[i + 1]; j++) {
+				jsonInt(writer, children[j]);
+			}
+
+			jsonEndArray(writer);
+		}
+
+		jsonEndObject(writer);
+	}
+
+	for (uint32_t i = 0; i < model->numMeshes; i++) {
+		const BG3DMesh * mesh = &model->meshes[i];
+
+		jsonBeginObject(writer);
+		jsonKey(writer, "mesh");
+		jsonInt(writer, i);
+
+		// quantized points are scaled back out by the node holding them
+		if (options->quantize && mesh->points != NULL && mesh->header.numPoints > 0) {
+			float offset[3], scale;
+			quantizeFrame(mesh, offset, &scale);
+
+			jsonKey(writer, "translation");
+			writeVec3(writer, offset);
+			jsonKey(writer, "scale");
+			writeVec3(writer, (float[3]) { scale, scale, scale });
+		}
+
+		jsonEndObject(writer);
+	}
+
+	jsonEndArray(writer);
+
+	free(first);
+	free(children);
+	return true;
+}
+
+// Both extensions change how the buffer has to be read, so they are
+// required as well as used. The fallback buffer has no data to fall back
+// on.
+static void writeExtensions (JSONWriter * writer, const BG3DExportOptions * options) {
+	const char * keys[2] = { "extensionsUsed", "extensionsRequired" };
+
+	for (int i = 0; i < 2; i++) {
+		jsonKey(writer, keys[i]);
+		jsonBeginArray(writer);
+
+		if (options->quantize) {
+			jsonString(writer, "KHR_mesh_quantization");
+		}
+
+		if (options->compress) {
+			jsonString(writer, "EXT_meshopt_compression");
+		}
+
+		jsonEndArray(writer);
+	}
+}
+
+// Writes the glTF describing the prepared buffer. The buffer is given
+// binName as its URI, or none for a GLB's own chunk, and images that aren't
+// embedded are found by imageName. Empty arrays are left out, since glTF
+// doesn't allow them.
+static BG3DError writeGLTF (JSONWriter * writer, const BG3DModel * model, const BG3DExportOptions * options, const GLTFBuffer * buffer, const char * binName, const char * imageName) {
+	size_t numArrays = buffer->numArrays;
+
+	jsonBeginObject(writer);
+
+	jsonKey(writer, "asset");
+	jsonBeginObject(writer);
+	jsonKey(writer, "version");
+	jsonString(writer, "2.0");
+	jsonEndObject(writer);
+
+	if ((options->quantize || options->compress) && numArrays > 0) {
+		writeExtensions(writer, options);
+	}
+
+	if (!writeNodes(writer, model, options)) {
+		return BG3D_ERROR_MEMORY;
+	}
+
+	if (model->numMeshes > 0) {
+		writeMeshes(writer, model, options);
+	}
+
+	if (model->numMaterials > 0) {
+		writeMaterials(writer, model, buffer);
+	}
+
+	if (buffer->numImages > 0) {
+		writeTextures(writer, model, buffer, imageName);
+	}
+
+	if (numArrays > 0) {
+		writeAccessors(writer, model, options);
+	}
+
+	if (buffer->byteLength > 0) {
+		writeBufferViews(writer, model, options, buffer);
+
+		jsonKey(writer, "buffers");
+		jsonBeginArray(writer);
+		jsonBeginObject(writer);
+
+		if (binName != NULL) {
+			jsonKey(writer, "uri");
+			jsonString(writer, binName);
+		}
+
+		jsonKey(writer, "byteLength");
+		jsonInt(writer, buffer->byteLength);
+		jsonEndObject(writer);
+
+		if (options->compress) {
+			jsonBeginObject(writer);
+			jsonKey(writer, "byteLength");
+			jsonInt(writer, buffer->fallbackLength);
+			jsonKey(writer, "extensions");
+			jsonBeginObject(writer);
+			jsonKey(writer, "EXT_meshopt_compression");
+			jsonBeginObject(writer);
+			jsonKey(writer, "fallback");
+			jsonBool(writer, true);
+			jsonEndObject(writer);
+			jsonEndObject(writer);
+			jsonEndObject(writer);
+		}
+
+		jsonEndArray(writer);
+	}
+
+	jsonEndObject(writer);
+
+	return finishJSONWriter(writer) ? BG3D_OK : BG3D_ERROR_WRITE;
+}
+
+// Encodes one of the mesh's arrays into the scratch space, padding it out
+// with zeros.
+static void encodeArray (const GLTFArray * array, const BG3DMesh * mesh, uint8_t * scratch) {
+	switch (array->encoding) {
+	case GLTF_INDICES16: {
+		narrowIndices16((uint16_t *) scratch, array->data, array->count);
+		break;
+	}
+	case GLTF_INDICES8: {
+		narrowIndices8(scratch, array->data, array->count);
+		break;
+	}
+	case GLTF_POINTS16: {
+		float offset[3], scale;
+		quantizeFrame(mesh, offset, &scale);
+		quantizePoints((int16_t *) scratch, array->data, array->count, offset, scale);
+		break;
+	}
+	case GLTF_NORMALS8: {
+		quantizeNormals((int8_t *) scratch, array->data, array->count);
+		break;
+	}
+	case GLTF_UVS16: {
+		quantizeUVs((uint16_t *) scratch, array->data, array->count);
+		break;
+	}
+	case GLTF_AS_IS:
+		break;
+	}
+
+	memset(scratch + array->length, 0, GLTF_ARRAY_SIZE(array) - array->length);
+}
+
+// Compresses the array, as laid out at data, into a meshopt stream in the
+// scratch space, padded out with zeros. Returns the stream's length.
+static size_t compressArray (const GLTFArray * array, const void * data, uint8_t * scratch) {
+	size_t length;
+
+	if (array->target == GLTF_ELEMENT_ARRAY_BUFFER) {
+		length = encodeIndexStream(scratch, array->data, array->count);
+	} else {
+		length = encodeVertexStream(scratch, data, array->count, GLTF_ELEMENT_SIZE(array));
+	}
+
+	memset(scratch + length, 0, GLTF_PADDED(length) - length);
+	return length;
+}
+
+static void freeBuffer (GLTFBuffer * buffer) {
+	if (buffer->images != NULL) {
+		for (uint32_t i = 0; i < buffer->numImages; i++) {
+			free(buffer->images[i]);
+		}
+	}
+
+	free(buffer->vectors);
+	free(buffer->streamLengths);
+	free(buffer->scratch);
+	free(buffer->images);
+	free(buffer->imageLengths);
+}
+
+// The textures are encoded on worker threads while the arrays are laid out,
+// each thread taking the next texture nobody has started on until there are
+// none left. They only ever write to their own texture's slots.
+typedef struct {
+	const BG3DModel * model;
+	const BG3DExportOptions * options;
+	GLTFBuffer * buffer;
+	BG3DError * errors;
+	uint32_t next;
+	pthread_t threads[MAX_IMAGE_THREADS];
+	int numThreads;
+	int blockThreads;
+} GLTFImageJobs;
+
+static void * encodeImages (void * arg) {
+	GLTFImageJobs * jobs = arg;
+	GLTFBuffer * buffer = jobs->buffer;
+	uint32_t i;
+
+	while ((i = __atomic_fetch_add(&jobs->next, 1, __ATOMIC_RELAXED)) < jobs->model->numTextures) {
+		const BG3DTexture * texture = &jobs->model->textures[i];
+
+		if (jobs->options->mipmaps || jobs->options->blocks != BG3D_BLOCKS_NONE) {
+			jobs->errors[i] = encodeKTX2(texture, jobs->model->variant, jobs->options->mipmaps, jobs->options->blocks,
+			                             jobs->blockThreads, &buffer->images[i], &buffer->imageLengths[i]);
+		} else {
+			jobs->errors[i] = encodePNG(texture, jobs->model->variant, jobs->options->textureLevel,
+			                            &buffer->images[i], &buffer->imageLengths[i]);
+		}
+	}
+
+	return NULL;
+}
+
+// Starts a thread for every texture, up to one per processor. Threads that
+// can't be started are no loss, since whatever is left over is encoded when
+// the images are finished. Any processors the textures leave spare go to
+// compressing their blocks, so the two together stay within one thread per
+// processor.
+static void startImages (GLTFImageJobs * jobs) {
+	long numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+	long wanted = jobs->model->numTextures;
+
+	if (wanted > numCPUs) {
+		wanted = numCPUs;
+	}
+
+	if (wanted > MAX_IMAGE_THREADS) {
+		wanted = MAX_IMAGE_THREADS;
+	}
+
+	jobs->blockThreads = wanted > 0 ? numCPUs / wanted : 1;
+
+	for (jobs->numThreads = 0; jobs->numThreads < wanted; jobs->numThreads++) {
+		if (pthread_create(&jobs->threads[jobs->numThreads], NULL, encodeImages, jobs) != 0) {
+			break;
+		}
+	}
+}
+
+// Helps with whatever textures are left, waits for the threads, and if the
+// images are to be embedded, puts them after the arrays in the buffer.
+static BG3DError finishImages (GLTFImageJobs * jobs, struct iovec * vector) {
+	static const uint8_t zeros[3] = { 0 };
+
+	GLTFBuffer * buffer = jobs->buffer;
+	BG3DError error = BG3D_OK;
+
+	encodeImages(jobs);
+
+	for (int i = 0; i < jobs->numThreads; i++) {
+		pthread_join(jobs->threads[i], NULL);
+	}
+
+	// every slot is filled in or still NULL, so they can all be freed
+	buffer->numImages = jobs->model->numTextures;
+
+	for (uint32_t i = 0; i < buffer->numImages; i++) {
+		if (jobs->errors[i] != BG3D_OK) {
+			error = jobs->errors[i];
+			continue;
+		}
+
+		size_t length = buffer->imageLengths[i];
+
+		if (buffer->imagesEmbedded) {
+			*vector++ = (struct iovec) { buffer->images[i], length };
+			*vector++ = (struct iovec) { (void *) zeros, GLTF_PADDED(length) - length };
+
+			buffer->byteLength += GLTF_PADDED(length);
+		}
+	}
+
+	return error;
+}
+
+// Lays out the buffer, encoding and compressing whatever needs it, with
+// before vectors free ahead of the arrays and one after them. The model's
+// textures are encoded too, and embedded after the arrays if asked.
+static BG3DError prepareBuffer (const BG3DModel * model, const BG3DExportOptions * options, GLTFBuffer * buffer, size_t before, bool embedImages) {
+	GLTFArray arrays[ARRAYS_PER_MESH];
+	size_t scratchLength;
+	uint32_t numImages = model->numTextures;
+
+	memset(buffer, 0, sizeof(GLTFBuffer));
+	buffer->imagesEmbedded = embedImages;
+	buffer->imageType = options->mipmaps || options->blocks != BG3D_BLOCKS_NONE ? "ktx2" : "png";
+	buffer->numArrays = countArrays(model, options, &buffer->fallbackLength, &scratchLength);
+	buffer->numVectors = buffer->numArrays + (embedImages ? numImages * 2 : 0);
+	buffer->byteLength = buffer->fallbackLength;
+	buffer->vectors = malloc((before + buffer->numVectors + 1) * sizeof(struct iovec));
+	buffer->streamLengths = malloc((buffer->numArrays + 1) * sizeof(size_t));
+	buffer->scratch = malloc(scratchLength + 1);
+	buffer->images = calloc(numImages + 1, sizeof(uint8_t *));
+	buffer->imageLengths = malloc((numImages + 1) * sizeof(size_t));
+
+	GLTFImageJobs jobs = {
+		.model = model,
+		.options = options,
+		.buffer = buffer,
+		.errors = malloc((numImages + 1) * sizeof(BG3DError))
+	};
+
+	if (buffer->vectors == NULL || buffer->streamLengths == NULL || buffer->scratch == NULL ||
+	    buffer->images == NULL || buffer->imageLengths == NULL || jobs.errors == NULL) {
+		free(jobs.errors);
+		freeBuffer(buffer);
+		return BG3D_ERROR_MEMORY;
+	}
+
+	// the textures take far longer than the arrays, so they start first
+	startImages(&jobs);
+
+	struct iovec * vector = buffer->vectors + before;
+	size_t * streamLength = buffer->streamLengths;
+	uint8_t * scratch = buffer->scratch;
+
+	if (options->compress) {
+		buffer->byteLength = 0;
+	}
+
+	for (uint32_t i = 0; i < model->numMeshes; i++) {
+		size_t n = meshArrays(&model->meshes[i], options, arrays);
+
+		for (size_t j = 0; j < n; j++, vector++) {
+			vector->iov_base = (void *) arrays[j].data;
+			vector->iov_len = GLTF_ARRAY_SIZE(&arrays[j]);
+
+			if (encodedArray(&arrays[j])) {
+				encodeArray(&arrays[j], &model->meshes[i], scratch);
+				vector->iov_base = scratch;
+				scratch += vector->iov_len;
+			}
+
+			if (options->compress) {
+				*streamLength = compressArray(&arrays[j], vector->iov_base, scratch);
+
+				// small arrays can come out bigger, and are better left alone
+				// as the accessor reads them, which vector already points at
+				if (*streamLength < arrays[j].length) {
+					vector->iov_base = scratch;
+					vector->iov_len = GLTF_PADDED(*streamLength);
+					scratch += vector->iov_len;
+				} else {
+					*streamLength = 0;
+				}
+
+				buffer->byteLength += vector->iov_len;
+				streamLength++;
+			}
+		}
+	}
+
+	BG3DError error = finishImages(&jobs, vector);
+	free(jobs.errors);
+
+	if (error != BG3D_OK) {
+		freeBuffer(buffer);
+		return error;
+	}
+
+	return BG3D_OK;
+}
+
+// Writes out every vector, picking up where the kernel left off after a
+// short write. The vectors are used up in the process.
+static bool writeVectors (int fd, struct iovec * vectors, size_t count) {
+	while (count > 0) {
+		ssize_t written = writev(fd, vectors, count < IOV_MAX ? count : IOV_MAX);
+
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (written < 0) {
+			return false;
+		}
+
+		while (count > 0 && (size_t) written >= vectors->iov_len) {
+			written -= vectors->iov_len;
+			vectors++;
+			count--;
+		}
+
+		if (count > 0) {
+			vectors->iov_base = (uint8_t *) vectors->iov_base + written;
+			vectors->iov_len -= written;
+		}
+	}
+
+	return true;
+}
+
+static bool writeFile (const char * path, struct iovec * vectors, size_t count) {
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0) {
+		return false;
+	}
+
+	bool written = writeVectors(fd, vectors, count);
+	return (close(fd) == 0) & written;
+}
+
+static bool saveImages (const GLTFBuffer * buffer, const char * outputName) {
+	for (uint32_t i = 0; i < buffer->numImages; i++) {
+		char outputPathTexture[PATH_LENGTH] = "";
+		texturePath(outputPathTexture, PATH_LENGTH, outputName, i, buffer->imageType);
+
+		struct iovec vector = { buffer->images[i], buffer->imageLengths[i] };
+
+		if (!writeFile(outputPathTexture, &vector, 1)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Writes outputName.gltf and the geometry beside it in outputName.bin, and
+// the textures as outputName.png, outputName_1.png, and so on, or .ktx2
+// with their mipmaps or blocks. The JSON is streamed straight to the file.
+BG3DError exportGLTF (const BG3DModel * model, const char * outputName, const BG3DExportOptions * options) {
+	BG3DError error;
+
+	char outputPathBin[PATH_LENGTH] = "";
+	snprintf(outputPathBin, PATH_LENGTH, "%s.bin", outputName);
+
+	GLTFBuffer buffer;
+
+	if ((error = prepareBuffer(model, options, &buffer, 0, false)) != BG3D_OK) {
+		return error;
+	}
+
+	if (!saveImages(&buffer, outputName)) {
+		freeBuffer(&buffer);
+		return BG3D_ERROR_WRITE;
+	}
+
+	if (buffer.numArrays > 0 && !writeFile(outputPathBin, buffer.vectors, buffer.numArrays)) {
+		freeBuffer(&buffer);
+		return BG3D_ERROR_WRITE;
+	}
+
+	// get the json output file name
+	char outputPathJSON[PATH_LENGTH] = "";
+	snprintf(outputPathJSON, PATH_LENGTH, "%s.gltf", outputName);
+
+	// open, write, close
+	FILE * pOutFile = fopen(outputPathJSON, "w");
+
+	if (pOutFile == NULL) {
+		freeBuffer(&buffer);
+		return BG3D_ERROR_WRITE;
+	}
+
+	// the .bin and texture files sit beside the .gltf, so they are referred
+	// to by their names alone
+	const char * binName = strrchr(outputPathBin, '/');
+	binName = binName ? binName + 1 : outputPathBin;
+
+	const char * imageName = strrchr(outputName, '/');
+	imageName = imageName ? imageName + 1 : outputName;
+
+	JSONWriter writer;
+	initJSONWriter(&writer, pOutFile);
+
+	error = writeGLTF(&writer, model, options, &buffer, binName, imageName);
+	fputc('\n', pOutFile);
+
+	if ((ferror(pOutFile) | fclose(pOutFile)) && error == BG3D_OK) {
+		error = BG3D_ERROR_WRITE;
+	}
+
+	freeBuffer(&buffer);
+	return error;
+}
+
+// Writes the model to outputName.glb, with its textures embedded as PNGs or
+// KTX2s, so the one file holds everything. The header, the JSON, the arrays and
+// the images all go out in one writev, straight from where they are, so
+// the file is never assembled in memory; only the JSON text is, since its
+// length leads the file.
+BG3DError exportGLB (const BG3DModel * model, const char * outputName, const BG3DExportOptions * options) {
+	BG3DError error;
+
+	// the header, the JSON chunk and the binary chunk's header and padding
+	// surround the arrays
+	GLTFBuffer buffer;
+
+	if ((error = prepareBuffer(model, options, &buffer, 4, true)) != BG3D_OK) {
+		return error;
+	}
+
+	JSONWriter writer;
+	initJSONWriter(&writer, NULL);
+
+	if ((error = writeGLTF(&writer, model, options, &buffer, NULL, NULL)) != BG3D_OK) {
+		freeJSONWriter(&writer);
+		freeBuffer(&buffer);
+		return error;
+	}
+
+	struct iovec * vectors = buffer.vectors;
+	size_t byteLength = buffer.byteLength;
+	size_t numVectors = buffer.numVectors;
+
+	static const char spaces[3] = "   ";
+	static const uint8_t zeros[3] = { 0 };
+
+	uint32_t jsonLength = writer.length;
+	uint32_t jsonChunkLength = jsonLength + GLB_PADDING(jsonLength);
+	uint32_t binChunkLength = byteLength + GLB_PADDING(byteLength);
+	uint32_t totalLength = 12 + 8 + jsonChunkLength + (byteLength > 0 ? 8 + binChunkLength : 0);
+
+	uint32_t header[5] = {
+		htole32(GLB_MAGIC), htole32(2), htole32(totalLength),
+		htole32(jsonChunkLength), htole32(GLB_CHUNK_JSON)
+	};
+	uint32_t binHeader[2] = { htole32(binChunkLength), htole32(GLB_CHUNK_BIN) };
+
+	vectors[0] = (struct iovec) { header, sizeof(header) };
+	vectors[1] = (struct iovec) { writer.text, jsonLength };
+	vectors[2] = (struct iovec) { (void *) spaces, GLB_PADDING(jsonLength) };
+	vectors[3] = (struct iovec) { binHeader, sizeof(binHeader) };
+	vectors[4 + numVectors] = (struct iovec) { (void *) zeros, GLB_PADDING(byteLength) };
+
+	// a model without geometry or textures has no binary chunk at all
+	size_t count = byteLength > 0 ? 4 + numVectors + 1 : 3;
+
+	char outputPathGLB[PATH_LENGTH] = "";
+	snprintf(outputPathGLB, PATH_LENGTH, "%s.glb", outputName);
+
+	if (!writeFile(outputPathGLB, vectors, count)) {
+		error = BG3D_ERROR_WRITE;
+	}
+
+	freeJSONWriter(&writer);
+	freeBuffer(&buffer);
+	return error;
+}
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+// The deepest nesting the comma bookkeeping can follow.
+#define JSON_MAX_DEPTH 64
+
+// With no file, the text is kept until the writer is freed.
+void initJSONWriter (JSONWriter * writer, FILE * file) {
+	memset(writer, 0, sizeof(JSONWriter));
+	writer->file = file;
+}
+
+static void jsonWrite (JSONWriter * writer, const char * text, size_t length) {
+	if (writer->failed) {
+		return;
+	}
+
+	if (writer->file != NULL) {
+		writer->failed = fwrite(text, 1, length, writer->file) != length;
+		return;
+	}
+
+	if (writer->length + length + 1 > writer->capacity) {
+		size_t capacity = writer->capacity ? writer->capacity * 2 : 4096;
+
+		while (capacity < writer->length + length + 1) {
+			capacity *= 2;
+		}
+
+		char * grown = realloc(writer->text, capacity);
+
+		if (grown == NULL) {
+			writer->failed = true;
+			return;
+		}
+
+		writer->text = grown;
+		writer->capacity = capacity;
+	}
+
+	// the text is always terminated, so it can be used as a string
+	memcpy(writer->text + writer->length, text, length);
+	writer->length += length;
+	writer->text[writer->length] = '\0';
+}
+
+// Puts a comma before every value but the first in an object or array,
+// unless the value follows its key.
+static void jsonSeparate (JSONWriter * writer) {
+	if (writer->afterKey) {
+		writer->afterKey = false;
+		return;
+	}
+
+	uint64_t bit = (uint64_t) 1 << writer->depth;
+
+	if (writer->hasItems & bit) {
+		jsonWrite(writer, ",", 1);
+	}
+
+	writer->hasItems |= bit;
+}
+
+static void jsonOpen (JSONWriter * writer, char bracket) {
+	jsonSeparate(writer);
+	jsonWrite(writer, &bracket, 1);
+
+	if (++writer->depth >= JSON_MAX_DEPTH) {
+		writer->failed = true;
+		writer->depth = JSON_MAX_DEPTH - 1;
+	}
+
+	writer->hasItems &= ~((uint64_t) 1 << writer->depth);
+}
+
+static void jsonClose (JSONWriter * writer, char bracket) {
+	writer->depth--;
+	jsonWrite(writer, &bracket, 1);
+}
+
+void jsonBeginObject (JSONWriter * writer) {
+	jsonOpen(writer, '{');
+}
+
+void jsonEndObject (JSONWriter * writer) {
+	jsonClose(writer, '}');
+}
+
+void jsonBeginArray (JSONWriter * writer) {
+	jsonOpen(writer, '[');
+}
+
+void jsonEndArray (JSONWriter * writer) {
+	jsonClose(writer, ']');
+}
+
+static void jsonQuote (JSONWriter * writer, const char * string) {
+	jsonWrite(writer, "\"", 1);
+
+	// runs of plain characters are written in one go
+	const char * run = string;
+
+	for (; *string != '\0'; string++) {
+		unsigned char c = *string;
+
+		if (c >= 0x20 && c != '"' && c != '\\') {
+			continue;
+		}
+
+		char escape[8];
+		jsonWrite(writer, run, string - run);
+		jsonWrite(writer, escape, snprintf(escape, sizeof(escape), "\\u%04x", c));
+		run = string + 1;
+	}
+
+	jsonWrite(writer, run, string - run);
+	jsonWrite(writer, "\"", 1);
+}
+
+void jsonKey (JSONWriter * writer, const char * key) {
+	jsonSeparate(writer);
+	jsonQuote(writer, key);
+	jsonWrite(writer, ":", 1);
+	writer->afterKey = true;
+}
+
+void jsonString (JSONWriter * writer, const char * string) {
+	jsonSeparate(writer);
+	jsonQuote(writer, string);
+}
+
+void jsonInt (JSONWriter * writer, int64_t value) {
+	char text[24];
+
+	jsonSeparate(writer);
+	jsonWrite(writer, text, snprintf(text, sizeof(text), "%lld", (long long) value));
+}
+
+// Nine significant digits are enough to read the same float back. JSON has
+// no infinities or NaNs, so those come out as 0.
+void jsonFloat (JSONWriter * writer, float value) {
+	char text[32];
+
+	if (value != value || value - value != 0) {
+		value = 0;
+	}
+
+	jsonSeparate(writer);
+	jsonWrite(writer, text, snprintf(text, sizeof(text), "%.9g", value));
+}
+
+void jsonBool (JSONWriter * writer, bool value) {
+	jsonSeparate(writer);
+	jsonWrite(writer, value ? "true" : "false", value ? 4 : 5);
+}
+
+// Returns whether everything was written.
+bool finishJSONWriter (JSONWriter * writer) {
+	if (writer->file != NULL && fflush(writer->file) != 0) {
+		writer->failed = true;
+	}
+
+	return !writer->failed && writer->depth == 0;
+}
+
+void freeJSONWriter (JSONWriter * writer) {
+	free(writer->text);
+	initJSONWriter(writer, NULL);
+}
@@ -0,0 +1,39 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// An append-only JSON emitter. Values are written out as they are given,
+// either straight to a file or to a growing string, so nothing is built up
+// in memory but the text itself. Commas are placed automatically; keys are
+// only valid inside objects. Any failure sticks and is reported at the end.
+typedef struct {
+  FILE * file;
+  char * text;
+  size_t length;
+  size_t capacity;
+  bool failed;
+
+  int depth;
+  uint64_t hasItems;
+  bool afterKey;
+} JSONWriter;
+
+void initJSONWriter (JSONWriter *, FILE *);
+bool finishJSONWriter (JSONWriter *);
+void freeJSONWriter (JSONWriter *);
+
+void jsonBeginObject (JSONWriter *);
+void jsonEndObject (JSONWriter *);
+void jsonBeginArray (JSONWriter *);
+void jsonEndArray (JSONWriter *);
+void jsonKey (JSONWriter *, const char *);
+
+void jsonString (JSONWriter *, const char *);
+void jsonInt (JSONWriter *, int64_t);
+void jsonFloat (JSONWriter *, float);
+void jsonBool (JSONWriter *, bool);
+
+#endif /* JSON_H */
@@ -0,0 +1,349 @@
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "common.h"
+
+// Writes textures as KTX2 files in memory, optionally with every mip level
+// down to 1x1, so engines don't have to make them each time a level loads.
+// The pixels are stored as 8 bit sRGB RGBA, whichever order they came in,
+// or compressed into BC1 blocks, or BC3 if any of them aren't opaque.
+//
+// Each level is filtered from the one above it by averaging 2x2 squares, in
+// linear light rather than on the sRGB values, which would darken them, and
+// with the colors weighted by their alpha, so transparent pixels don't bleed
+// their color into the ones around them. A side that's odd loses its last
+// row or column; one that's already 1 is used twice.
+
+#define KTX_HEADER_SIZE 80
+#define KTX_LEVEL_SIZE 24
+
+// The data format descriptor: its total size, the basic block's header and
+// a sample for each channel, or each half of a BC3 block.
+#define KTX_DFD_SIZE(samples) (4 + 24 + (samples) * 16)
+
+// The one key the file carries, its length, key and value, padded to 4.
+#define KTX_WRITER "KTXwriter\0libbg3d"
+#define KTX_KVD_SIZE 24
+
+// The channels the samples name. The block formats call their colors 0
+// too, and BC3 its alpha 15.
+#define KTX_CHANNEL_ALPHA 15
+#define KTX_SAMPLE_LINEAR 0x10
+
+typedef enum {
+	KTX_RGBA8,
+	KTX_BC1,
+	KTX_BC3
+} KTXFormat;
+
+// Each format's Vulkan number, sRGB in every case, its texel block's bytes
+// and sides, and how many samples describe it.
+static const uint32_t vkFormats[3] = { 43, 132, 138 };
+static const uint32_t blockBytes[3] = { 4, 8, 16 };
+static const uint32_t blockSides[3] = { 1, 4, 4 };
+static const uint32_t numSamples[3] = { 4, 1, 2 };
+
+static float srgbToLinear[256];
+
+// Textures are encoded on several threads at once, so this only ever runs
+// once.
+static pthread_once_t srgbOnce = PTHREAD_ONCE_INIT;
+
+static void initSrgbTable () {
+	for (int i = 0; i < 256; i++) {
+		float c = i / 255.0f;
+		srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+	}
+}
+
+static uint8_t linearToSrgb (float c) {
+	c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+	return (uint8_t) lrintf(fminf(fmaxf(c, 0.0f), 1.0f) * 255.0f);
+}
+
+// Turns count RGBA pixels into linear light premultiplied by their alpha,
+// four floats each.
+static void loadLevel (float * dst, const uint8_t * src, size_t count) {
+	for (size_t i = 0; i < count; i++, src += 4, dst += 4) {
+		float alpha = src[3] / 255.0f;
+
+		for (int j = 0; j < 3; j++) {
+			dst[j] = srgbToLinear[src[j]] * alpha;
+		}
+
+		dst[3] = alpha;
+	}
+}
+
+// Turns them back. Pixels with no alpha left at all come out black.
+static void storeLevel (uint8_t * dst, const float * src, size_t count) {
+	for (size_t i = 0; i < count; i++, src += 4, dst += 4) {
+		float alpha = src[3];
+		float inverse = alpha > 0.0f ? 1.0f / alpha : 0.0f;
+
+		for (int j = 0; j < 3; j++) {
+			dst[j] = linearToSrgb(src[j] * inverse);
+		}
+
+		dst[3] = (uint8_t) lrintf(fminf(alpha, 1.0f) * 255.0f);
+	}
+}
+
+// Averages each 2x2 square of a width by height level into one pixel of the
+// next. It works in place, since every pixel lands on ones already read.
+static void boxFilter (float * pixels, uint32_t width, uint32_t height) {
+	uint32_t nextWidth = width > 1 ? width / 2 : 1;
+	uint32_t nextHeight = height > 1 ? height / 2 : 1;
+	float * dst = pixels;
+
+	for (uint32_t y = 0; y < nextHeight; y++) {
+		const float * row0 = pixels + (size_t) 2 * y * width * 4;
+		const float * row1 = height > 1 ? row0 + (size_t) width * 4 : row0;
+
+		for (uint32_t x = 0; x < nextWidth; x++, dst += 4) {
+			size_t x0 = (size_t) 2 * x * 4;
+			size_t x1 = width > 1 ? x0 + 4 : x0;
+
+#ifdef __SSE2__
+			// a pixel is exactly one vector
+			__m128 top = _mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1));
+			__m128 bottom = _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1));
+			_mm_storeu_ps(dst, _mm_mul_ps(_mm_add_ps(top, bottom), _mm_set1_ps(0.25f)));
+#else
+			for (int j = 0; j < 4; j++) {
+				dst[j] = (row0[x0 + j] + row0[x1 + j] + row1[x0 + j] + row1[x1 + j]) * 0.25f;
+			}
+#endif
+		}
+	}
+}
+
+static uint8_t * putU32 (uint8_t * out, uint32_t value) {
+	value = htole32(value);
+	memcpy(out, &value, 4);
+	return out + 4;
+}
+
+static uint8_t * putU64 (uint8_t * out, uint64_t value) {
+	value = htole64(value);
+	memcpy(out, &value, 8);
+	return out + 8;
+}
+
+static uint8_t * putSample (uint8_t * out, uint32_t bitOffset, uint32_t bitLength, uint32_t channel, uint32_t upper) {
+	out = putU32(out, bitOffset | (bitLength - 1) << 16 | channel << 24);
+	out = putU32(out, 0);
+	out = putU32(out, 0);
+	return putU32(out, upper);
+}
+
+// Describes the format, with BT.709 primaries, the sRGB transfer function,
+// and the alpha stored straight and linear.
+static uint8_t * putDescriptor (uint8_t * out, KTXFormat format) {
+	// RGBSDA, BC1A and BC3, as the descriptor numbers them
+	static const uint32_t colorModels[3] = { 1, 128, 130 };
+
+	uint32_t side = blockSides[format] - 1;
+
+	out = putU32(out, KTX_DFD_SIZE(numSamples[format]));
+	out = putU32(out, 0);
+	out = putU32(out, 2 | (KTX_DFD_SIZE(numSamples[format]) - 4) << 16);
+	out = putU32(out, colorModels[format] | 1 << 8 | 2 << 16);
+	out = putU32(out, side | side << 8);
+	out = putU32(out, blockBytes[format]);
+	out = putU32(out, 0);
+
+	switch (format) {
+	case KTX_RGBA8: {
+		for (uint32_t i = 0; i < 3; i++) {
+			out = putSample(out, 8 * i, 8, i, 255);
+		}
+
+		out = putSample(out, 24, 8, KTX_CHANNEL_ALPHA | KTX_SAMPLE_LINEAR, 255);
+		break;
+	}
+	case KTX_BC1: {
+		out = putSample(out, 0, 64, 0, UINT32_MAX);
+		break;
+	}
+	case KTX_BC3: {
+		out = putSample(out, 0, 64, KTX_CHANNEL_ALPHA | KTX_SAMPLE_LINEAR, UINT32_MAX);
+		out = putSample(out, 64, 64, 0, UINT32_MAX);
+		break;
+	}
+	}
+
+	return out;
+}
+
+// Gray pixels, with alpha if there are two bytes of them, are spread over
+// all three colors, the way PNG shows them.
+static void expandGray (uint8_t * dst, const uint8_t * src, size_t count, size_t channels) {
+	for (size_t i = 0; i < count; i++, src += channels, dst += 4) {
+		dst[0] = dst[1] = dst[2] = src[0];
+		dst[3] = channels == 2 ? src[1] : 0xff;
+	}
+}
+
+static bool hasAlpha (const uint8_t * pixels, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		if (pixels[i * 4 + 3] != 255) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Stores one level of RGBA pixels as they are or in blocks.
+static void putLevel (uint8_t * out, const uint8_t * pixels, uint32_t width, uint32_t height, KTXFormat format, BG3DBlockCompression blocks, int maxThreads) {
+	if (format == KTX_RGBA8) {
+		memcpy(out, pixels, (size_t) width * height * 4);
+	} else {
+		compressBlocks(out, pixels, width, height, format == KTX_BC3, blocks, maxThreads);
+	}
+}
+
+// Encodes the texture as a KTX2 file, with its whole mip chain if asked,
+// in memory that the caller frees. Blocks are compressed on up to
+// maxThreads threads. As with PNG, textures whose size doesn't come to 1 to
+// 4 bytes per pixel can't be written.
+BG3DError encodeKTX2 (const BG3DTexture * texture, BG3DVariant variant, bool mipmaps, BG3DBlockCompression blocks, int maxThreads, uint8_t ** ktx, size_t * length) {
+	static const uint8_t identifier[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+	static const uint8_t fromARGB[4] = { 1, 2, 3, 0 };
+	static const uint8_t fromRGB[3] = { 0, 1, 2 };
+
+	const BG3DTextureHeader * header = &texture->header;
+	uint32_t width = header->width;
+	uint32_t height = header->height;
+	uint64_t numPixels = (uint64_t) width * height;
+
+	if (texture->pixels == NULL || numPixels == 0 || header->bufferSize % numPixels != 0 ||
+	    header->bufferSize / numPixels < 1 || header->bufferSize / numPixels > 4) {
+		return BG3D_ERROR_STRUCTURE;
+	}
+
+	size_t channels = header->bufferSize / numPixels;
+
+	pthread_once(&srgbOnce, initSrgbTable);
+
+	uint32_t numLevels = 1;
+
+	while (mipmaps && (width | height) >> numLevels) {
+		numLevels++;
+	}
+
+	// every level is worked on as RGBA, the first one being the texture's
+	// own pixels, only put in order
+	uint8_t * rgba = malloc(numPixels * 4);
+	float * pixels = numLevels > 1 ? malloc(numPixels * 4 * sizeof(float)) : NULL;
+
+	if (rgba == NULL || (numLevels > 1 && pixels == NULL)) {
+		free(rgba);
+		free(pixels);
+		return BG3D_ERROR_MEMORY;
+	}
+
+	if (channels < 3) {
+		expandGray(rgba, texture->pixels, numPixels, channels);
+	} else if (channels == 3) {
+		expandPixels(rgba, texture->pixels, numPixels, fromRGB);
+	} else if (variant == BG3D_VARIANT_BOOK) {
+		swizzlePixels(rgba, texture->pixels, numPixels, fromARGB);
+	} else {
+		memcpy(rgba, texture->pixels, numPixels * 4);
+	}
+
+	KTXFormat format = KTX_RGBA8;
+
+	if (blocks != BG3D_BLOCKS_NONE) {
+		format = hasAlpha(rgba, numPixels) ? KTX_BC3 : KTX_BC1;
+	}
+
+	// the levels go smallest first, so a file can be streamed in, each
+	// starting on a whole texel block
+	uint32_t dfdSize = KTX_DFD_SIZE(numSamples[format]);
+	uint32_t side = blockSides[format];
+	size_t offsets[32];
+	size_t size = KTX_HEADER_SIZE + KTX_LEVEL_SIZE * numLevels + dfdSize + KTX_KVD_SIZE;
+
+	for (uint32_t i = numLevels; i-- > 0;) {
+		size_t levelWidth = width >> i ? width >> i : 1;
+		size_t levelHeight = height >> i ? height >> i : 1;
+
+		size = (size + blockBytes[format] - 1) / blockBytes[format] * blockBytes[format];
+		offsets[i] = size;
+		size += (levelWidth + side - 1) / side * ((levelHeight + side - 1) / side) * blockBytes[format];
+	}
+
+	uint8_t * out = calloc(size, 1);
+
+	if (out == NULL) {
+		free(rgba);
+		free(pixels);
+		return BG3D_ERROR_MEMORY;
+	}
+
+	uint8_t * p = out;
+	memcpy(p, identifier, sizeof(identifier));
+	p += sizeof(identifier);
+
+	p = putU32(p, vkFormats[format]);
+	p = putU32(p, 1);
+	p = putU32(p, width);
+	p = putU32(p, height);
+	p = putU32(p, 0);
+	p = putU32(p, 0);
+	p = putU32(p, 1);
+	p = putU32(p, numLevels);
+	p = putU32(p, 0);
+
+	p = putU32(p, KTX_HEADER_SIZE + KTX_LEVEL_SIZE * numLevels);
+	p = putU32(p, dfdSize);
+	p = putU32(p, KTX_HEADER_SIZE + KTX_LEVEL_SIZE * numLevels + dfdSize);
+	p = putU32(p, KTX_KVD_SIZE);
+	p = putU64(p, 0);
+	p = putU64(p, 0);
+
+	for (uint32_t i = 0; i < numLevels; i++) {
+		size_t levelWidth = width >> i ? width >> i : 1;
+		size_t levelHeight = height >> i ? height >> i : 1;
+		size_t levelLength = (levelWidth + side - 1) / side * ((levelHeight + side - 1) / side) * blockBytes[format];
+
+		p = putU64(p, offsets[i]);
+		p = putU64(p, levelLength);
+		p = putU64(p, levelLength);
+	}
+
+	p = putDescriptor(p, format);
+
+	p = putU32(p, sizeof(KTX_WRITER));
+	memcpy(p, KTX_WRITER, sizeof(KTX_WRITER));
+
+	putLevel(out + offsets[0], rgba, width, height, format, blocks, maxThreads);
+
+	if (numLevels > 1) {
+		loadLevel(pixels, rgba, numPixels);
+	}
+
+	for (uint32_t i = 1; i < numLevels; i++) {
+		uint32_t levelWidth = width >> i ? width >> i : 1;
+		uint32_t levelHeight = height >> i ? height >> i : 1;
+
+		boxFilter(pixels, width >> (i - 1) ? width >> (i - 1) : 1, height >> (i - 1) ? height >> (i - 1) : 1);
+		storeLevel(rgba, pixels, (size_t) levelWidth * levelHeight);
+		putLevel(out + offsets[i], rgba, levelWidth, levelHeight, format, blocks, maxThreads);
+	}
+
+	free(rgba);
+	free(pixels);
+
+	*ktx = out;
+	*length = size;
+	return BG3D_OK;
+}
@@ -0,0 +1,72 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include "bg3d.h"
+
+// Helpers for the parts of the format that differ between variants. They
+// are always inlined and callers pass a constant variant, so every parse
+// loop gets its own layout compiled in and never tests the variant per tag.
+#define LAYOUT_INLINE static inline __attribute__((always_inline))
+
+LAYOUT_INLINE size_t textureHeaderSize (BG3DVariant variant) {
+	return variant == BG3D_VARIANT_BOOK ? sizeof(BG3DBookTextureHeader) : sizeof(BG3DOttoTextureHeader);
+}
+
+LAYOUT_INLINE size_t meshHeaderSize (BG3DVariant variant) {
+	return variant == BG3D_VARIANT_BOOK ? sizeof(BG3DBookMeshHeader) : sizeof(BG3DOttoMeshHeader);
+}
+
+// Offsets of the decoded fields within the on-disk headers, for the report.
+#define TEXTURE_FIELD_OFFSET(variant, field) \
+	((variant) == BG3D_VARIANT_BOOK ? offsetof(BG3DBookTextureHeader, field) : offsetof(BG3DOttoTextureHeader, field))
+
+#define MESH_FIELD_OFFSET(variant, field, ottoField) \
+	((variant) == BG3D_VARIANT_BOOK ? offsetof(BG3DBookMeshHeader, field) : offsetof(BG3DOttoMeshHeader, ottoField))
+
+LAYOUT_INLINE void decodeTextureHeader (const void * view, BG3DVariant variant, BG3DTextureHeader * header) {
+	if (variant == BG3D_VARIANT_BOOK) {
+		BG3DBookTextureHeader raw;
+		memcpy(&raw, view, sizeof(raw));
+
+		header->width = be32toh(raw.width);
+		header->height = be32toh(raw.height);
+		header->srcPixelFormat = 0;
+		header->dstPixelFormat = 0;
+		header->bufferSize = be32toh(raw.bufferSize);
+	} else {
+		BG3DOttoTextureHeader raw;
+		memcpy(&raw, view, sizeof(raw));
+
+		header->width = be32toh(raw.width);
+		header->height = be32toh(raw.height);
+		header->srcPixelFormat = be32toh(raw.srcPixelFormat);
+		header->dstPixelFormat = be32toh(raw.dstPixelFormat);
+		header->bufferSize = be32toh(raw.bufferSize);
+	}
+}
+
+LAYOUT_INLINE void decodeMeshHeader (const void * view, BG3DVariant variant, BG3DMeshHeader * header) {
+	if (variant == BG3D_VARIANT_BOOK) {
+		BG3DBookMeshHeader raw;
+		memcpy(&raw, view, sizeof(raw));
+
+		header->materialNum = be32toh(raw.materialNum);
+		header->flags = be32toh(raw.flags);
+		header->numPoints = be32toh(raw.numPoints);
+		header->numTriangles = be32toh(raw.numTriangles);
+	} else {
+		BG3DOttoMeshHeader raw;
+		memcpy(&raw, view, sizeof(raw));
+
+		// only the first material layer is ever used
+		header->materialNum = be32toh(raw.layerMaterialNum[0]);
+		header->flags = be32toh(raw.flags);
+		header->numPoints = be32toh(raw.numPoints);
+		header->numTriangles = be32toh(raw.numTriangles);
+	}
+}
+
+#endif /* LAYOUT_H */
@@ -1,45 +1,145 @@
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
-#include "arg.c"
-#include "bg3d.c"
+#include "arg.h"
+#include "common.h"
 
-int main(int argc, char *argv[]) {
-	setArgState(argc, argv);
+// With several inputs, -o names a directory and each model is written into
+// it under the name of its file, without the extension.
+static void outputNameFor (const char * path, char * name, size_t size) {
+	if (numInputs == 1) {
+		snprintf(name, size, "%s", outputName);
+		return;
+	}
+
+	const char * base = strrchr(path, '/');
+	base = base ? base + 1 : path;
+
+	if (strcmp(path, "-") == 0) {
+		base = "stdin";
+	}
+
+	const char * extension = strrchr(base, '.');
+	int length = extension ? (int) (extension - base) : (int) strlen(base);
 
-	FILE * pFile;
-	pFile = fopen(inputPath, "r");
+	snprintf(name, size, "%s/%.*s", outputName, length, base);
+}
 
-	if (pFile == NULL) {
-		perror("Error Opening File.\n");
-		die();
+// Reads one file into the model and does whatever was asked of it.
+static BG3DError convertFile (BG3DReader * pReader, BG3DModel * model, const char * path) {
+	BG3DError error;
+
+	if (strcmp(path, "-") == 0) {
+		error = openStreamReader(pReader, STDIN_FILENO, false);
+	} else {
+		error = openReader(pReader, path);
 	}
 
-	readHeader(pFile);
-	parseFile(pFile);
+	if (error != BG3D_OK) {
+		return error;
+	}
+
+	if (argState & 1) {
+		pReader->report = stdout;
+	}
+
+	// nothing is exported, so the payloads are never needed
+	if (!(argState & 2)) {
+		setMetadataOnly(pReader);
+	}
+
+	if ((error = readHeader(pReader, model)) != BG3D_OK) {
+		return error;
+	}
+
+	if (argState & 4) {
+		BG3DToc toc;
+
+		if ((error = buildToc(pReader, &toc)) != BG3D_OK) {
+			return error;
+		}
+
+		printToc(&toc, stdout);
+		freeToc(&toc);
+	}
 
-	fclose(pFile);
+	// the table of contents alone never needs the payloads, but anything
+	// else, a plain run included, parses the file to check it
+	if (argState != 4) {
+		if ((error = parseFile(pReader, model)) != BG3D_OK) {
+			return error;
+		}
+	}
 
-	extern uint8_t argState;
+	if (argState & 0x10) {
+		if ((error = weldModel(model)) != BG3D_OK) {
+			return setError(pReader, error, "Error Welding Vertices.");
+		}
+	}
 
 	if (argState & 2) {
-		// get json string
-		extern json_object * outputJSON;
-		const char * jsonString = json_object_to_json_string(outputJSON);
+		// one material for every mesh is common, and most of them are the same
+		if ((error = mergeMaterials(model)) != BG3D_OK) {
+			return setError(pReader, error, "Error Merging Materials.");
+		}
+
+		char name[4096];
+		outputNameFor(path, name, sizeof(name));
+
+		BG3DExportOptions options = {
+			.quantize = (argState & 0x20) != 0,
+			.compress = (argState & 0x40) != 0,
+			.textureLevel = textureLevel,
+			.mipmaps = (argState & 0x100) != 0,
+			.blocks = (BG3DBlockCompression) blockFit
+		};
 
-		// get the json output file name
-		extern char * outputName;
-		char outputPathJSON[100] = "";
-		snprintf(outputPathJSON, 100, "%s.gltf", outputName);
+		error = (argState & 8) ? exportGLB(model, name, &options) : exportGLTF(model, name, &options);
 
-		// open, write, close
-		FILE * pOutFile = fopen(outputPathJSON, "w");
-		fprintf(pOutFile, "%s\n", jsonString);
-		fclose(pOutFile);
+		if (error != BG3D_OK) {
+			return setError(pReader, error, "Error Writing the Output.");
+		}
+	}
+
+	return BG3D_OK;
+}
 
-		//free
-		json_object_put(outputJSON);
+// Logs why a file failed, so the rest of the batch can carry on.
+static void reportError (const BG3DReader * pReader, BG3DError error, const char * path) {
+	if (error == BG3D_ERROR_OPEN || error == BG3D_ERROR_WRITE) {
+		fprintf(stderr, "%s: %s (%s)\n", path, pReader->errorMessage, strerror(errno));
+	} else {
+		fprintf(stderr, "%s: %s (%s at 0x%zx)\n", path, pReader->errorMessage,
+		        errorString(error), pReader->errorOffset);
 	}
+}
+
+int main(int argc, char *argv[]) {
+	setArgState(argc, argv);
+
+	BG3DModel model;
+	initModel(&model);
+
+	int failed = 0;
+
+	// one model is reused for every file, so its memory is only allocated once
+	for (int i = 0; i < numInputs; i++) {
+		BG3DReader reader;
+		BG3DError error = convertFile(&reader, &model, inputPaths[i]);
+
+		if (error != BG3D_OK) {
+			reportError(&reader, error, inputPaths[i]);
+			failed++;
+		}
+
+		// the model's textures point into the reader, so it goes first
+		resetModel(&model);
+		closeReader(&reader);
+	}
+
+	freeModel(&model);
 
-	return 0;
+	return failed ? 1 : 0;
 }
@@ -0,0 +1,439 @@
+#include <string.h>
+
+#include "common.h"
+
+// Encoders for the byte streams of EXT_meshopt_compression, as its
+// specification lays them out: version 0 of the vertex codec and version 1
+// of the index codec. Decoders can only read what follows the format
+// exactly, so every choice below is spelled out by it.
+
+// Vertex streams are split into blocks of up to 256 vertices, encoded one
+// byte of the vertex at a time as deltas from the vertex before, in groups
+// of 16 bytes.
+#define VERTEX_HEADER 0xa0
+#define VERTEX_BLOCK_BYTES 8192
+#define VERTEX_BLOCK_MAX 256
+#define BYTE_GROUP 16
+#define TAIL_MAX 32
+
+#define INDEX_HEADER 0xe0
+#define INDEX_VERSION 1
+
+static size_t vertexBlockSize (size_t stride) {
+	size_t size = (VERTEX_BLOCK_BYTES / stride) & ~(size_t) (BYTE_GROUP - 1);
+	return size < VERTEX_BLOCK_MAX ? size : VERTEX_BLOCK_MAX;
+}
+
+// The tail holds the first vertex, padded at the front to 32 bytes, which
+// is where the decoder starts the deltas from.
+static size_t vertexTailSize (size_t stride) {
+	return stride < TAIL_MAX ? TAIL_MAX : stride;
+}
+
+// The most a stream of count vertices stride bytes apart can take, if no
+// group can be packed at all.
+size_t vertexStreamBound (size_t count, size_t stride) {
+	size_t blockSize = vertexBlockSize(stride);
+	size_t numBlocks = (count + blockSize - 1) / blockSize;
+	size_t headerSize = (blockSize / BYTE_GROUP + 3) / 4;
+
+	return 1 + numBlocks * stride * (headerSize + blockSize) + vertexTailSize(stride);
+}
+
+// How many bytes a group takes packed into the given number of bits per
+// byte, with the bytes that don't fit following it whole. One bit stands
+// for a group of zeros, which takes none at all.
+static size_t measureGroup (const uint8_t * group, int bits) {
+	if (bits == 1) {
+		for (int i = 0; i < BYTE_GROUP; i++) {
+			if (group[i] != 0) {
+				return SIZE_MAX;
+			}
+		}
+
+		return 0;
+	}
+
+	if (bits == 8) {
+		return BYTE_GROUP;
+	}
+
+	size_t size = BYTE_GROUP * bits / 8;
+	uint8_t sentinel = (1 << bits) - 1;
+
+	for (int i = 0; i < BYTE_GROUP; i++) {
+		size += group[i] >= sentinel;
+	}
+
+	return size;
+}
+
+// Packs the bytes into bits each, first byte in the highest bits. Bytes
+// too big for that are written as the sentinel of all ones, then in full.
+static uint8_t * packGroup (uint8_t * out, const uint8_t * group, int bits) {
+	if (bits == 1) {
+		return out;
+	}
+
+	if (bits == 8) {
+		memcpy(out, group, BYTE_GROUP);
+		return out + BYTE_GROUP;
+	}
+
+	uint8_t sentinel = (1 << bits) - 1;
+	int perByte = 8 / bits;
+
+	for (int i = 0; i < BYTE_GROUP; i += perByte) {
+		uint8_t byte = 0;
+
+		for (int k = 0; k < perByte; k++) {
+			uint8_t value = group[i + k] >= sentinel ? sentinel : group[i + k];
+			byte = (byte << bits) | value;
+		}
+
+		*out++ = byte;
+	}
+
+	for (int i = 0; i < BYTE_GROUP; i++) {
+		if (group[i] >= sentinel) {
+			*out++ = group[i];
+		}
+	}
+
+	return out;
+}
+
+// Writes the groups behind a header holding two bits for each: 0 for
+// zeros, then 2, 4 or 8 bits a byte, whichever packs smallest.
+static uint8_t * encodeBytes (uint8_t * out, const uint8_t * bytes, size_t count) {
+	static const int widths[4] = { 1, 2, 4, 8 };
+
+	uint8_t * header = out;
+	size_t headerSize = (count / BYTE_GROUP + 3) / 4;
+
+	memset(header, 0, headerSize);
+	out += headerSize;
+
+	for (size_t i = 0; i < count; i += BYTE_GROUP) {
+		int best = 3;
+		size_t bestSize = measureGroup(bytes + i, 8);
+
+		for (int j = 0; j < 3; j++) {
+			size_t size = measureGroup(bytes + i, widths[j]);
+
+			if (size < bestSize) {
+				best = j;
+				bestSize = size;
+			}
+		}
+
+		size_t group = i / BYTE_GROUP;
+		header[group / 4] |= best << ((group % 4) * 2);
+
+		out = packGroup(out, bytes + i, widths[best]);
+	}
+
+	return out;
+}
+
+// Deltas are zigzagged so small steps either way become small bytes.
+static uint8_t * encodeVertexBlock (uint8_t * out, const uint8_t * vertices, size_t count, size_t stride, uint8_t * last) {
+	uint8_t bytes[VERTEX_BLOCK_MAX];
+
+	// the groups are whole, so whatever is past the last vertex is zero
+	memset(bytes, 0, sizeof(bytes));
+
+	for (size_t k = 0; k < stride; k++) {
+		uint8_t previous = last[k];
+
+		for (size_t i = 0; i < count; i++) {
+			uint8_t value = vertices[i * stride + k];
+			uint8_t delta = value - previous;
+
+			bytes[i] = (delta << 1) ^ (uint8_t) ((int8_t) delta >> 7);
+			previous = value;
+		}
+
+		out = encodeBytes(out, bytes, (count + BYTE_GROUP - 1) & ~(size_t) (BYTE_GROUP - 1));
+	}
+
+	memcpy(last, vertices + (count - 1) * stride, stride);
+	return out;
+}
+
+// Encodes count vertices, stride bytes each, into out, which must have
+// room for vertexStreamBound of them. The stride has to be a multiple of 4
+// no larger than 256. Returns the length of the stream.
+size_t encodeVertexStream (uint8_t * out, const void * vertices, size_t count, size_t stride) {
+	const uint8_t * in = vertices;
+	uint8_t * start = out;
+	uint8_t first[256] = { 0 };
+	uint8_t last[256];
+
+	if (count > 0) {
+		memcpy(first, in, stride);
+	}
+
+	memcpy(last, first, stride);
+
+	*out++ = VERTEX_HEADER;
+
+	size_t blockSize = vertexBlockSize(stride);
+
+	for (size_t i = 0; i < count; i += blockSize) {
+		size_t n = count - i < blockSize ? count - i : blockSize;
+		out = encodeVertexBlock(out, in + i * stride, n, stride, last);
+	}
+
+	size_t padding = vertexTailSize(stride) - stride;
+
+	memset(out, 0, padding);
+	memcpy(out + padding, first, stride);
+
+	return out + padding + stride - start;
+}
+
+// Index streams describe each triangle with a code byte, from what the
+// last few triangles left in a FIFO of 16 edges and one of 16 vertices.
+// Anything new is either the next vertex never seen before or written
+// out as a delta from the last one written.
+typedef struct {
+	uint32_t edges[16][2];
+	uint32_t vertices[16];
+	size_t edgeOffset;
+	size_t vertexOffset;
+	uint32_t next;
+	uint32_t last;
+} IndexState;
+
+// Which pairs of feb and fec a code can name without an extra byte.
+static const uint8_t codeAuxTable[16] = {
+	0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xa9, 0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69,
+	0, 0
+};
+
+static const int triangleOrder[3][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 } };
+
+// Finds an edge of the triangle in the FIFO, returning how far back it is
+// times 4 plus which edge of the triangle it is, or -1.
+static int findEdge (const IndexState * state, uint32_t a, uint32_t b, uint32_t c) {
+	for (int i = 0; i < 16; i++) {
+		const uint32_t * edge = state->edges[(state->edgeOffset - 1 - i) & 15];
+
+		if (edge[0] == a && edge[1] == b) {
+			return (i << 2) | 0;
+		}
+
+		if (edge[0] == b && edge[1] == c) {
+			return (i << 2) | 1;
+		}
+
+		if (edge[0] == c && edge[1] == a) {
+			return (i << 2) | 2;
+		}
+	}
+
+	return -1;
+}
+
+static void pushEdge (IndexState * state, uint32_t a, uint32_t b) {
+	state->edges[state->edgeOffset][0] = a;
+	state->edges[state->edgeOffset][1] = b;
+	state->edgeOffset = (state->edgeOffset + 1) & 15;
+}
+
+static int findVertex (const IndexState * state, uint32_t v) {
+	for (int i = 0; i < 16; i++) {
+		if (state->vertices[(state->vertexOffset - 1 - i) & 15] == v) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void pushVertex (IndexState * state, uint32_t v) {
+	state->vertices[state->vertexOffset] = v;
+	state->vertexOffset = (state->vertexOffset + 1) & 15;
+}
+
+// Writes the index as a zigzagged delta from the last one written, seven
+// bits a byte, and makes it the last.
+static uint8_t * writeIndex (uint8_t * out, IndexState * state, uint32_t index) {
+	uint32_t delta = index - state->last;
+	uint32_t v = (delta << 1) ^ (uint32_t) ((int32_t) delta >> 31);
+
+	do {
+		*out++ = (v & 127) | (v > 127 ? 128 : 0);
+		v >>= 7;
+	} while (v);
+
+	state->last = index;
+	return out;
+}
+
+// The most count indices can take: each triangle's code, and up to an
+// extra byte and three full indices, then the table.
+size_t indexStreamBound (size_t count) {
+	return 1 + count / 3 * 17 + 16;
+}
+
+// A triangle sharing an edge with one in the FIFO only needs its third
+// vertex, which is the next new one, one in the vertex FIFO, one either
+// side of the last, or written out.
+static uint8_t * encodeEdgeTriangle (uint8_t * out, uint8_t * code, IndexState * state, const uint32_t * triangle, int edge) {
+	const int * order = triangleOrder[edge & 3];
+	uint32_t a = triangle[order[0]], b = triangle[order[1]], c = triangle[order[2]];
+
+	int fc = findVertex(state, c);
+	int fec;
+
+	if (fc >= 1 && fc < 13) {
+		fec = fc;
+	} else if (c == state->next) {
+		fec = 0;
+		state->next++;
+	} else if (c + 1 == state->last) {
+		fec = 13;
+		state->last = c;
+	} else if (c == state->last + 1) {
+		fec = 14;
+		state->last = c;
+	} else {
+		fec = 15;
+		out = writeIndex(out, state, c);
+	}
+
+	*code = (edge >> 2) << 4 | fec;
+
+	if (fec == 0 || fec >= 13) {
+		pushVertex(state, c);
+	}
+
+	pushEdge(state, c, b);
+	pushEdge(state, a, c);
+	return out;
+}
+
+// Other triangles are rotated to start with the next new vertex if they
+// have it. The other two are coded together in a byte, or in the code by
+// the table if they can be. Starting over at 0, 1, 2 resets the next
+// vertex, which lets a stream of joined meshes stay cheap.
+static uint8_t * encodeNewTriangle (uint8_t * out, uint8_t * code, IndexState * state, const uint32_t * triangle) {
+	int rotation = triangle[1] == state->next ? 1 : triangle[2] == state->next ? 2 : 0;
+	const int * order = triangleOrder[rotation];
+	uint32_t a = triangle[order[0]], b = triangle[order[1]], c = triangle[order[2]];
+
+	bool reset = a == 0 && b == 1 && c == 2 && state->next > 0;
+
+	if (reset) {
+		state->next = 0;
+		memset(state->vertices, 0xff, sizeof(state->vertices));
+	}
+
+	int fb = findVertex(state, b);
+	int fc = findVertex(state, c);
+	int fea, feb, fec;
+
+	if (a == state->next) {
+		fea = 0;
+		state->next++;
+	} else {
+		fea = 15;
+	}
+
+	if (fb >= 0 && fb < 14) {
+		feb = fb + 1;
+	} else if (b == state->next) {
+		feb = 0;
+		state->next++;
+	} else {
+		feb = 15;
+	}
+
+	if (fc >= 0 && fc < 14) {
+		fec = fc + 1;
+	} else if (c == state->next) {
+		fec = 0;
+		state->next++;
+	} else {
+		fec = 15;
+	}
+
+	uint8_t codeAux = feb << 4 | fec;
+	int entry = -1;
+
+	for (int i = 0; i < 14; i++) {
+		if (codeAuxTable[i] == codeAux) {
+			entry = i;
+			break;
+		}
+	}
+
+	if (fea == 0 && entry >= 0 && !reset) {
+		*code = 0xf0 | entry;
+	} else {
+		*code = 0xfe | (fea == 15);
+		*out++ = codeAux;
+	}
+
+	if (fea == 15) {
+		out = writeIndex(out, state, a);
+	}
+
+	if (feb == 15) {
+		out = writeIndex(out, state, b);
+	}
+
+	if (fec == 15) {
+		out = writeIndex(out, state, c);
+	}
+
+	pushVertex(state, a);
+
+	if (feb == 0 || feb == 15) {
+		pushVertex(state, b);
+	}
+
+	if (fec == 0 || fec == 15) {
+		pushVertex(state, c);
+	}
+
+	pushEdge(state, b, a);
+	pushEdge(state, c, b);
+	pushEdge(state, a, c);
+	return out;
+}
+
+// Encodes count indices, a multiple of 3, into out, which must have room
+// for indexStreamBound of them. Triangles keep their winding but may start
+// from another corner. Returns the length of the stream.
+size_t encodeIndexStream (uint8_t * out, const uint32_t * indices, size_t count) {
+	IndexState state;
+
+	memset(state.edges, 0xff, sizeof(state.edges));
+	memset(state.vertices, 0xff, sizeof(state.vertices));
+	state.edgeOffset = state.vertexOffset = 0;
+	state.next = state.last = 0;
+
+	out[0] = INDEX_HEADER | INDEX_VERSION;
+
+	uint8_t * code = out + 1;
+	uint8_t * data = code + count / 3;
+
+	for (size_t i = 0; i < count; i += 3, code++) {
+		const uint32_t * triangle = indices + i;
+		int edge = findEdge(&state, triangle[0], triangle[1], triangle[2]);
+
+		if (edge >= 0 && (edge >> 2) < 15) {
+			data = encodeEdgeTriangle(data, code, &state, triangle, edge);
+		} else {
+			data = encodeNewTriangle(data, code, &state, triangle);
+		}
+	}
+
+	// the table also pads the stream out for the decoder
+	memcpy(data, codeAuxTable, sizeof(codeAuxTable));
+
+	return data + sizeof(codeAuxTable) - out;
+}
@@ -0,0 +1,164 @@
+#include <string.h>
+
+#include "common.h"
+
+void initModel (BG3DModel * model) {
+	memset(model, 0, sizeof(BG3DModel));
+	initArena(&model->arena);
+	initBounds(&model->bounds);
+	model->currentGroup = -1;
+}
+
+// Empties the model for the next file, keeping its memory.
+void resetModel (BG3DModel * model) {
+	BG3DArena arena = model->arena;
+
+	resetArena(&arena);
+	memset(model, 0, sizeof(BG3DModel));
+
+	model->arena = arena;
+	initBounds(&model->bounds);
+	model->currentGroup = -1;
+}
+
+void freeModel (BG3DModel * model) {
+	freeArena(&model->arena);
+	initModel(model);
+}
+
+void initBounds (BG3DBounds * bounds) {
+	for (int i = 0; i < 3; i++) {
+		bounds->min[i] = __builtin_inff();
+		bounds->max[i] = -__builtin_inff();
+	}
+}
+
+// Widens bounds to take in other as well.
+void mergeBounds (BG3DBounds * bounds, const BG3DBounds * other) {
+	for (int i = 0; i < 3; i++) {
+		bounds->min[i] = other->min[i] < bounds->min[i] ? other->min[i] : bounds->min[i];
+		bounds->max[i] = other->max[i] > bounds->max[i] ? other->max[i] : bounds->max[i];
+	}
+}
+
+// Appends a zeroed element to one of the model's arrays, doubling the
+// allocation whenever the count reaches a power of two. Returns NULL, with
+// the array untouched, if the arena is out of memory.
+static void * appendElement (BG3DArena * arena, void * array, uint32_t * count, size_t size) {
+	uint32_t n = *count;
+	char * elements = array;
+
+	if ((n & (n - 1)) == 0) {
+		elements = arenaGrow(arena, elements, n * size, (n ? n * 2 : 1) * size);
+
+		if (elements == NULL) {
+			return NULL;
+		}
+	}
+
+	memset(elements + n * size, 0, size);
+	*count = n + 1;
+
+	return elements;
+}
+
+BG3DMaterial * addMaterial (BG3DModel * model) {
+	BG3DMaterial * materials = appendElement(&model->arena, model->materials, &model->numMaterials, sizeof(BG3DMaterial));
+
+	if (materials == NULL) {
+		return NULL;
+	}
+
+	model->materials = materials;
+	BG3DMaterial * material = &model->materials[model->numMaterials - 1];
+	material->textureNum = -1;
+
+	return material;
+}
+
+BG3DTexture * addTexture (BG3DModel * model) {
+	BG3DTexture * textures = appendElement(&model->arena, model->textures, &model->numTextures, sizeof(BG3DTexture));
+
+	if (textures == NULL) {
+		return NULL;
+	}
+
+	model->textures = textures;
+	return &model->textures[model->numTextures - 1];
+}
+
+BG3DGroup * addGroup (BG3DModel * model) {
+	BG3DGroup * groups = appendElement(&model->arena, model->groups, &model->numGroups, sizeof(BG3DGroup));
+
+	if (groups == NULL) {
+		return NULL;
+	}
+
+	model->groups = groups;
+
+	BG3DGroup * group = &model->groups[model->numGroups - 1];
+	group->parent = model->currentGroup;
+	initBounds(&group->bounds);
+
+	return group;
+}
+
+BG3DMesh * addMesh (BG3DModel * model) {
+	BG3DMesh * meshes = appendElement(&model->arena, model->meshes, &model->numMeshes, sizeof(BG3DMesh));
+
+	if (meshes == NULL) {
+		return NULL;
+	}
+
+	model->meshes = meshes;
+
+	BG3DMesh * mesh = &model->meshes[model->numMeshes - 1];
+	mesh->group = model->currentGroup;
+	initBounds(&mesh->bounds);
+
+	return mesh;
+}
+
+// Collapses materials that are the same in every field into the first of
+// them, keeping the rest in order, and points the meshes at what's left.
+// Meshes with no material of their own keep the number they had.
+BG3DError mergeMaterials (BG3DModel * model) {
+	uint32_t numMaterials = model->numMaterials;
+
+	if (numMaterials < 2) {
+		return BG3D_OK;
+	}
+
+	uint32_t * remap = arenaAlloc(&model->arena, numMaterials * sizeof(uint32_t));
+
+	if (remap == NULL) {
+		return BG3D_ERROR_MEMORY;
+	}
+
+	uint32_t numUnique = 0;
+
+	for (uint32_t i = 0; i < numMaterials; i++) {
+		uint32_t j = 0;
+
+		while (j < numUnique && memcmp(&model->materials[j], &model->materials[i], sizeof(BG3DMaterial)) != 0) {
+			j++;
+		}
+
+		if (j == numUnique) {
+			model->materials[numUnique++] = model->materials[i];
+		}
+
+		remap[i] = j;
+	}
+
+	for (uint32_t i = 0; i < model->numMeshes; i++) {
+		BG3DMeshHeader * header = &model->meshes[i].header;
+
+		if (header->materialNum < numMaterials) {
+			header->materialNum = remap[header->materialNum];
+		}
+	}
+
+	model->numMaterials = numUnique;
+	return BG3D_OK;
+}
@@ -0,0 +1,1123 @@
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PNG_X86
+#endif
+
+#include "common.h"
+
+// Writes textures as PNG files in memory, with a deflate of its own so no
+// library is needed. The pixels go in as they are, in whichever of PNG's 8
+// bit color types matches the texture's bytes per pixel; only the book's
+// ARGB has to be turned around.
+//
+// The level trades speed for size. Level 0 stores the rows unfiltered and
+// uncompressed. Level 1 filters them and only looks for runs, repeats of
+// the byte or pixel before. Higher levels search hash chains for matches,
+// deeper the higher they go, and from level 4 try every filter on every row.
+// Each block goes out with whichever of dynamic codes, fixed codes or no
+// compression at all comes out smallest.
+
+#define PNG_GRAY 0
+#define PNG_RGB 2
+#define PNG_GRAY_ALPHA 4
+#define PNG_RGBA 6
+
+#define FILTER_NONE 0
+#define FILTER_SUB 1
+#define FILTER_UP 2
+#define FILTER_AVERAGE 3
+#define FILTER_PAETH 4
+
+// The most a stored deflate block can hold.
+#define STORED_BLOCK 65535
+
+#define WINDOW_SIZE 32768
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define HASH_BITS 15
+
+// Matches are kept as their length and distance, which can't be mistaken for
+// literals since every length is at least 3.
+#define BLOCK_SYMBOLS 32768
+#define MATCH_SYMBOL(length, distance) ((uint32_t) (length) << 16 | (distance))
+
+#define NUM_LITLEN 286
+#define NUM_DIST 30
+#define NUM_CODELEN 19
+
+static const uint8_t codeLengthOrder[NUM_CODELEN] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// How hard each level looks for matches: how many candidates it follows
+// down a chain, the length that's good enough to stop at, and whether it
+// checks the next position for something longer before taking a match.
+typedef struct {
+	uint32_t maxChain;
+	uint32_t niceLength;
+	bool lazy;
+} MatchLevel;
+
+static const MatchLevel matchLevels[10] = {
+	{ 0, 0, false },
+	{ 0, 0, false },
+	{ 4, 16, false },
+	{ 8, 32, false },
+	{ 16, 64, false },
+	{ 32, 128, true },
+	{ 64, 128, true },
+	{ 128, 258, true },
+	{ 512, 258, true },
+	{ 4096, 258, true }
+};
+
+// CRC-32, as PNG's chunks use it. The SSE 4.2 crc32 instruction computes
+// CRC-32C, a different polynomial, so the fast version folds with carryless
+// multiplies instead.
+
+static uint32_t crcTable[256];
+
+static void initCrcTable () {
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t c = i;
+
+		for (int k = 0; k < 8; k++) {
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		}
+
+		crcTable[i] = c;
+	}
+}
+
+// The crc is kept inverted between calls to the kernels.
+static uint32_t crc32Scalar (uint32_t crc, const uint8_t * data, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+
+	return crc;
+}
+
+#ifdef PNG_X86
+// Folds four 128 bit lanes at a time down the data, then those into one,
+// then reduces that to 32 bits, following Intel's paper on CRC with
+// PCLMULQDQ. The constants are powers of x modulo the bit reflected
+// polynomial. Whatever is left past the last 16 bytes goes through the
+// table.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32PCLMUL (uint32_t crc, const uint8_t * data, size_t length) {
+	if (length < 64) {
+		return crc32Scalar(crc, data, length);
+	}
+
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+	const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	__m128i x1 = _mm_loadu_si128((const __m128i *) data);
+	__m128i x2 = _mm_loadu_si128((const __m128i *) (data + 16));
+	__m128i x3 = _mm_loadu_si128((const __m128i *) (data + 32));
+	__m128i x4 = _mm_loadu_si128((const __m128i *) (data + 48));
+
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	data += 64;
+	length -= 64;
+
+	for (; length >= 64; data += 64, length -= 64) {
+		__m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		__m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		__m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		__m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *) data));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *) (data + 16)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *) (data + 32)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *) (data + 48)));
+	}
+
+	__m128i lanes[3] = { x2, x3, x4 };
+
+	for (int i = 0; i < 3; i++) {
+		__m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, lanes[i]), x5);
+	}
+
+	for (; length >= 16; data += 16, length -= 16) {
+		__m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *) data)), x5);
+	}
+
+	// 128 bits down to 64, then the Barrett reduction to 32
+	__m128i folded = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), folded);
+
+	folded = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), k5, 0x00);
+	x1 = _mm_xor_si128(x1, folded);
+
+	folded = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), poly, 0x10);
+	folded = _mm_clmulepi64_si128(_mm_and_si128(folded, low32), poly, 0x00);
+	x1 = _mm_xor_si128(x1, folded);
+
+	return crc32Scalar(_mm_extract_epi32(x1, 1), data, length);
+}
+#endif // PNG_X86
+
+static uint32_t (*crc32Kernel) (uint32_t, const uint8_t *, size_t);
+
+// Several textures can be encoded at once, so this only ever runs once.
+static pthread_once_t crc32Once = PTHREAD_ONCE_INIT;
+
+// Fills the table, which the fast kernel needs for its tail too, and picks
+// a kernel the first time a CRC is needed.
+static void selectCrc32 () {
+	initCrcTable();
+	crc32Kernel = crc32Scalar;
+
+#ifdef PNG_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+		crc32Kernel = crc32PCLMUL;
+	}
+#endif // PNG_X86
+}
+
+static uint32_t crc32 (uint32_t crc, const uint8_t * data, size_t length) {
+	pthread_once(&crc32Once, selectCrc32);
+	return ~crc32Kernel(~crc, data, length);
+}
+
+static uint32_t adler32 (const uint8_t * data, size_t length) {
+	uint32_t a = 1, b = 0;
+
+	while (length > 0) {
+		// the sums can go this long without overflowing
+		size_t n = length < 5552 ? length : 5552;
+
+		for (size_t i = 0; i < n; i++) {
+			a += data[i];
+			b += a;
+		}
+
+		a %= 65521;
+		b %= 65521;
+		data += n;
+		length -= n;
+	}
+
+	return b << 16 | a;
+}
+
+static uint8_t * putU32 (uint8_t * out, uint32_t value) {
+	value = htobe32(value);
+	memcpy(out, &value, 4);
+	return out + 4;
+}
+
+// Finishes the chunk whose length and type start at chunk, now that its
+// data runs up to end.
+static uint8_t * endChunk (uint8_t * chunk, uint8_t * end) {
+	uint32_t length = end - chunk - 8;
+
+	putU32(chunk, length);
+	return putU32(end, crc32(0, chunk + 4, length + 4));
+}
+
+static uint8_t paeth (uint8_t a, uint8_t b, uint8_t c) {
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+
+	if (pa <= pb && pa <= pc) {
+		return a;
+	}
+
+	return pb <= pc ? b : c;
+}
+
+// Filters one row of length bytes against the one above it, which is all
+// zeros for the first. The bytes to the left of the row count as zero too.
+static void filterRow (uint8_t * out, const uint8_t * row, const uint8_t * prev, size_t length, size_t bpp, int type) {
+	size_t x = 0;
+
+	switch (type) {
+	case FILTER_NONE: {
+		memcpy(out, row, length);
+		break;
+	}
+	case FILTER_SUB: {
+		for (; x < bpp && x < length; x++) {
+			out[x] = row[x];
+		}
+
+#ifdef __SSE2__
+		for (; x + 16 <= length; x += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i *) (row + x - bpp));
+			__m128i r = _mm_loadu_si128((const __m128i *) (row + x));
+			_mm_storeu_si128((__m128i *) (out + x), _mm_sub_epi8(r, a));
+		}
+#endif
+
+		for (; x < length; x++) {
+			out[x] = row[x] - row[x - bpp];
+		}
+
+		break;
+	}
+	case FILTER_UP: {
+#ifdef __SSE2__
+		for (; x + 16 <= length; x += 16) {
+			__m128i b = _mm_loadu_si128((const __m128i *) (prev + x));
+			__m128i r = _mm_loadu_si128((const __m128i *) (row + x));
+			_mm_storeu_si128((__m128i *) (out + x), _mm_sub_epi8(r, b));
+		}
+#endif
+
+		for (; x < length; x++) {
+			out[x] = row[x] - prev[x];
+		}
+
+		break;
+	}
+	case FILTER_AVERAGE: {
+		for (; x < bpp && x < length; x++) {
+			out[x] = row[x] - (prev[x] >> 1);
+		}
+
+#ifdef __SSE2__
+		// pavgb rounds up, so the odd sums are taken back down
+		for (; x + 16 <= length; x += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i *) (row + x - bpp));
+			__m128i b = _mm_loadu_si128((const __m128i *) (prev + x));
+			__m128i r = _mm_loadu_si128((const __m128i *) (row + x));
+			__m128i odd = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1));
+			__m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), odd);
+			_mm_storeu_si128((__m128i *) (out + x), _mm_sub_epi8(r, average));
+		}
+#endif
+
+		for (; x < length; x++) {
+			out[x] = row[x] - ((row[x - bpp] + prev[x]) >> 1);
+		}
+
+		break;
+	}
+	case FILTER_PAETH: {
+		for (; x < bpp && x < length; x++) {
+			out[x] = row[x] - prev[x];
+		}
+
+		for (; x < length; x++) {
+			out[x] = row[x] - paeth(row[x - bpp], prev[x], prev[x - bpp]);
+		}
+
+		break;
+	}
+	}
+}
+
+// The usual guess at how well a filtered row will compress: the sum of its
+// bytes taken as signed, ignoring the sign. Lower is better.
+static uint64_t scoreRow (const uint8_t * row, size_t length) {
+	uint64_t score = 0;
+	size_t x = 0;
+
+#ifdef __SSE2__
+	__m128i sums = _mm_setzero_si128();
+
+	for (; x + 16 <= length; x += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (row + x));
+		__m128i magnitude = _mm_min_epu8(v, _mm_sub_epi8(_mm_setzero_si128(), v));
+		sums = _mm_add_epi64(sums, _mm_sad_epu8(magnitude, _mm_setzero_si128()));
+	}
+
+	// stored rather than moved out, since 32 bit x86 has no 64 bit move
+	uint64_t lanes[2];
+	_mm_storeu_si128((__m128i *) lanes, sums);
+	score = lanes[0] + lanes[1];
+#endif
+
+	for (; x < length; x++) {
+		score += row[x] < 128 ? row[x] : 256 - row[x];
+	}
+
+	return score;
+}
+
+// Filters every row into out, each after its filter type byte. Level 0
+// leaves them all unfiltered; the rest pick the filter that scores best,
+// from all five at level 4 and up, or the quick three below that.
+static bool filterRows (uint8_t * out, const uint8_t * pixels, size_t width, size_t height, size_t bpp, int level) {
+	size_t rowSize = width * bpp;
+	int numFilters = level == 0 ? 1 : level < 4 ? 3 : 5;
+	uint8_t * scratch = calloc(rowSize, 2);
+
+	if (scratch == NULL) {
+		return false;
+	}
+
+	const uint8_t * zeros = scratch + rowSize;
+
+	for (size_t y = 0; y < height; y++, out += 1 + rowSize) {
+		const uint8_t * row = pixels + y * rowSize;
+		const uint8_t * prev = y > 0 ? row - rowSize : zeros;
+		uint64_t best = UINT64_MAX;
+
+		out[0] = FILTER_NONE;
+		filterRow(out + 1, row, prev, rowSize, bpp, FILTER_NONE);
+
+		if (numFilters > 1) {
+			best = scoreRow(out + 1, rowSize);
+		}
+
+		for (int type = 1; type < numFilters; type++) {
+			filterRow(scratch, row, prev, rowSize, bpp, type);
+
+			uint64_t score = scoreRow(scratch, rowSize);
+
+			if (score < best) {
+				best = score;
+				out[0] = type;
+				memcpy(out + 1, scratch, rowSize);
+			}
+		}
+	}
+
+	free(scratch);
+	return true;
+}
+
+typedef struct {
+	uint32_t freq;
+	uint16_t symbol;
+} Leaf;
+
+static int compareLeaves (const void * a, const void * b) {
+	const Leaf * x = a;
+	const Leaf * y = b;
+
+	if (x->freq != y->freq) {
+		return x->freq < y->freq ? -1 : 1;
+	}
+
+	return x->symbol - y->symbol;
+}
+
+// Works out code lengths for the symbols' frequencies, none longer than
+// limit. Codes that run too long are built again from flattened
+// frequencies until they fit. At least two symbols always get a code, since
+// inflaters reject a code with only one.
+static void buildLengths (uint8_t * lengths, const uint32_t * freqs, int n, int limit) {
+	Leaf leaves[NUM_LITLEN];
+	uint32_t weights[NUM_LITLEN * 2];
+	uint16_t parents[NUM_LITLEN * 2];
+	uint8_t depths[NUM_LITLEN * 2];
+	int m = 0;
+
+	memset(lengths, 0, n);
+
+	for (int i = 0; i < n; i++) {
+		if (freqs[i] > 0) {
+			leaves[m++] = (Leaf) { freqs[i], i };
+		}
+	}
+
+	for (int i = 0; m < 2; i++) {
+		if (freqs[i] == 0) {
+			leaves[m++] = (Leaf) { 1, i };
+		}
+	}
+
+	for (;;) {
+		qsort(leaves, m, sizeof(Leaf), compareLeaves);
+
+		// the leaves come in sorted and the merged nodes are made in order
+		// of weight, so the two lightest are always at the front of one or
+		// the other
+		int nextLeaf = 0, nextNode = m, numNodes = m;
+
+		for (int i = 0; i < m; i++) {
+			weights[i] = leaves[i].freq;
+		}
+
+		for (int i = 0; i < m - 1; i++) {
+			int pick[2];
+
+			for (int j = 0; j < 2; j++) {
+				if (nextLeaf < m && (nextNode >= numNodes || weights[nextLeaf] <= weights[nextNode])) {
+					pick[j] = nextLeaf++;
+				} else {
+					pick[j] = nextNode++;
+				}
+			}
+
+			weights[numNodes] = weights[pick[0]] + weights[pick[1]];
+			parents[pick[0]] = parents[pick[1]] = numNodes;
+			numNodes++;
+		}
+
+		int maxDepth = 0;
+		depths[numNodes - 1] = 0;
+
+		for (int i = numNodes - 2; i >= 0; i--) {
+			depths[i] = depths[parents[i]] + 1;
+
+			if (depths[i] > maxDepth) {
+				maxDepth = depths[i];
+			}
+		}
+
+		if (maxDepth <= limit) {
+			for (int i = 0; i < m; i++) {
+				lengths[leaves[i].symbol] = depths[i];
+			}
+
+			return;
+		}
+
+		for (int i = 0; i < m; i++) {
+			leaves[i].freq = (leaves[i].freq >> 1) | 1;
+		}
+	}
+}
+
+// Assigns the canonical codes for the lengths, bit reversed since deflate
+// writes them starting from the top bit.
+static void buildCodes (uint16_t * codes, const uint8_t * lengths, int n) {
+	uint16_t counts[16] = { 0 };
+	uint16_t next[16];
+
+	for (int i = 0; i < n; i++) {
+		counts[lengths[i]]++;
+	}
+
+	counts[0] = 0;
+	uint16_t code = 0;
+
+	for (int bits = 1; bits < 16; bits++) {
+		code = (code + counts[bits - 1]) << 1;
+		next[bits] = code;
+	}
+
+	for (int i = 0; i < n; i++) {
+		int length = lengths[i];
+
+		if (length == 0) {
+			continue;
+		}
+
+		uint16_t c = next[length]++;
+		uint16_t reversed = 0;
+
+		for (int b = 0; b < length; b++) {
+			reversed = (reversed << 1) | ((c >> b) & 1);
+		}
+
+		codes[i] = reversed;
+	}
+}
+
+typedef struct {
+	uint8_t * out;
+	uint64_t bits;
+	int numBits;
+} BitWriter;
+
+static void putBits (BitWriter * writer, uint32_t value, int count) {
+	writer->bits |= (uint64_t) value << writer->numBits;
+	writer->numBits += count;
+
+	while (writer->numBits >= 8) {
+		*writer->out++ = writer->bits;
+		writer->bits >>= 8;
+		writer->numBits -= 8;
+	}
+}
+
+static void alignBits (BitWriter * writer) {
+	if (writer->numBits > 0) {
+		putBits(writer, 0, 8 - writer->numBits);
+	}
+}
+
+// Lengths from 3 to 258 and distances from 1 to 32768 map to their codes by
+// how many bits they have, the codes coming in groups that share extra bits.
+static int lengthCode (uint32_t length, uint32_t * extra, int * numExtra) {
+	uint32_t l = length - MIN_MATCH;
+
+	*extra = 0;
+
+	if (length == MAX_MATCH) {
+		*numExtra = 0;
+		return 285;
+	}
+
+	if (l < 8) {
+		*numExtra = 0;
+		return 257 + l;
+	}
+
+	int b = 31 - __builtin_clz(l);
+	*numExtra = b - 2;
+	*extra = l & ((1u << *numExtra) - 1);
+	return 257 + 4 * (b - 1) + ((l >> (b - 2)) & 3);
+}
+
+static int distanceCode (uint32_t distance, uint32_t * extra, int * numExtra) {
+	uint32_t d = distance - 1;
+
+	*extra = 0;
+
+	if (d < 4) {
+		*numExtra = 0;
+		return d;
+	}
+
+	int b = 31 - __builtin_clz(d);
+	*numExtra = b - 1;
+	*extra = d & ((1u << *numExtra) - 1);
+	return 2 * b + ((d >> (b - 1)) & 1);
+}
+
+// A block's symbols, counted up, and the codes to write them with.
+typedef struct {
+	uint32_t litlenFreqs[NUM_LITLEN];
+	uint32_t distFreqs[NUM_DIST];
+	uint8_t litlenLengths[NUM_LITLEN];
+	uint8_t distLengths[NUM_DIST];
+	uint16_t litlenCodes[NUM_LITLEN];
+	uint16_t distCodes[NUM_DIST];
+	uint64_t extraBits;
+} BlockCodes;
+
+static void countSymbols (BlockCodes * block, const uint32_t * symbols, size_t count) {
+	memset(block->litlenFreqs, 0, sizeof(block->litlenFreqs));
+	memset(block->distFreqs, 0, sizeof(block->distFreqs));
+	block->extraBits = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t symbol = symbols[i];
+
+		if (symbol < 256) {
+			block->litlenFreqs[symbol]++;
+			continue;
+		}
+
+		uint32_t extra;
+		int numLengthExtra, numDistExtra;
+
+		block->litlenFreqs[lengthCode(symbol >> 16, &extra, &numLengthExtra)]++;
+		block->distFreqs[distanceCode(symbol & 0xffff, &extra, &numDistExtra)]++;
+		block->extraBits += numLengthExtra + numDistExtra;
+	}
+
+	block->litlenFreqs[256] = 1;
+}
+
+static uint64_t codedBits (const BlockCodes * block) {
+	uint64_t bits = block->extraBits;
+
+	for (int i = 0; i < NUM_LITLEN; i++) {
+		bits += (uint64_t) block->litlenFreqs[i] * block->litlenLengths[i];
+	}
+
+	for (int i = 0; i < NUM_DIST; i++) {
+		bits += (uint64_t) block->distFreqs[i] * block->distLengths[i];
+	}
+
+	return bits;
+}
+
+// The fixed code has two more lengths than can be used, which still count
+// towards the codes of the rest.
+static void fixedCodes (BlockCodes * block) {
+	uint8_t lengths[NUM_LITLEN + 2];
+	uint16_t codes[NUM_LITLEN + 2];
+
+	for (int i = 0; i < NUM_LITLEN + 2; i++) {
+		lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+	}
+
+	buildCodes(codes, lengths, NUM_LITLEN + 2);
+	memcpy(block->litlenLengths, lengths, sizeof(block->litlenLengths));
+	memcpy(block->litlenCodes, codes, sizeof(block->litlenCodes));
+
+	memset(block->distLengths, 5, sizeof(block->distLengths));
+	buildCodes(block->distCodes, block->distLengths, NUM_DIST);
+}
+
+// The code lengths of a dynamic block, run length coded with the code
+// length alphabet's repeats.
+typedef struct {
+	uint8_t symbols[NUM_LITLEN + NUM_DIST];
+	uint8_t extras[NUM_LITLEN + NUM_DIST];
+	size_t count;
+	int numLitlen;
+	int numDist;
+	int numCodeLengths;
+	uint32_t freqs[NUM_CODELEN];
+	uint8_t lengths[NUM_CODELEN];
+	uint16_t codes[NUM_CODELEN];
+} CodeLengths;
+
+static const uint8_t repeatBits[3] = { 2, 3, 7 };
+
+static void addCodeLength (CodeLengths * header, uint8_t symbol, uint8_t extra) {
+	header->symbols[header->count] = symbol;
+	header->extras[header->count++] = extra;
+	header->freqs[symbol]++;
+}
+
+static void encodeCodeLengths (CodeLengths * header, const BlockCodes * block) {
+	uint8_t all[NUM_LITLEN + NUM_DIST];
+
+	header->numLitlen = NUM_LITLEN;
+	header->numDist = NUM_DIST;
+
+	while (header->numLitlen > 257 && block->litlenLengths[header->numLitlen - 1] == 0) {
+		header->numLitlen--;
+	}
+
+	while (header->numDist > 1 && block->distLengths[header->numDist - 1] == 0) {
+		header->numDist--;
+	}
+
+	size_t total = header->numLitlen + header->numDist;
+	memcpy(all, block->litlenLengths, header->numLitlen);
+	memcpy(all + header->numLitlen, block->distLengths, header->numDist);
+
+	header->count = 0;
+	memset(header->freqs, 0, sizeof(header->freqs));
+
+	for (size_t i = 0; i < total;) {
+		uint8_t length = all[i];
+		size_t run = 1;
+
+		while (i + run < total && all[i + run] == length) {
+			run++;
+		}
+
+		i += run;
+
+		if (length == 0) {
+			for (; run >= 11; run -= run < 138 ? run : 138) {
+				addCodeLength(header, 18, (run < 138 ? run : 138) - 11);
+			}
+
+			if (run >= 3) {
+				addCodeLength(header, 17, run - 3);
+				run = 0;
+			}
+		} else {
+			addCodeLength(header, length, 0);
+			run--;
+
+			for (; run >= 3; run -= run < 6 ? run : 6) {
+				addCodeLength(header, 16, (run < 6 ? run : 6) - 3);
+			}
+		}
+
+		for (; run > 0; run--) {
+			addCodeLength(header, length, 0);
+		}
+	}
+
+	buildLengths(header->lengths, header->freqs, NUM_CODELEN, 7);
+	buildCodes(header->codes, header->lengths, NUM_CODELEN);
+
+	header->numCodeLengths = NUM_CODELEN;
+
+	while (header->numCodeLengths > 4 && header->lengths[codeLengthOrder[header->numCodeLengths - 1]] == 0) {
+		header->numCodeLengths--;
+	}
+}
+
+static uint64_t headerBits (const CodeLengths * header) {
+	uint64_t bits = 5 + 5 + 4 + 3 * header->numCodeLengths;
+
+	for (size_t i = 0; i < header->count; i++) {
+		uint8_t symbol = header->symbols[i];
+		bits += header->lengths[symbol] + (symbol >= 16 ? repeatBits[symbol - 16] : 0);
+	}
+
+	return bits;
+}
+
+static void writeHeader (BitWriter * writer, const CodeLengths * header) {
+	putBits(writer, header->numLitlen - 257, 5);
+	putBits(writer, header->numDist - 1, 5);
+	putBits(writer, header->numCodeLengths - 4, 4);
+
+	for (int i = 0; i < header->numCodeLengths; i++) {
+		putBits(writer, header->lengths[codeLengthOrder[i]], 3);
+	}
+
+	for (size_t i = 0; i < header->count; i++) {
+		uint8_t symbol = header->symbols[i];
+		putBits(writer, header->codes[symbol], header->lengths[symbol]);
+
+		if (symbol >= 16) {
+			putBits(writer, header->extras[i], repeatBits[symbol - 16]);
+		}
+	}
+}
+
+static void writeSymbols (BitWriter * writer, const BlockCodes * block, const uint32_t * symbols, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		uint32_t symbol = symbols[i];
+
+		if (symbol < 256) {
+			putBits(writer, block->litlenCodes[symbol], block->litlenLengths[symbol]);
+			continue;
+		}
+
+		uint32_t extra;
+		int numExtra;
+		int code = lengthCode(symbol >> 16, &extra, &numExtra);
+
+		putBits(writer, block->litlenCodes[code], block->litlenLengths[code]);
+		putBits(writer, extra, numExtra);
+
+		code = distanceCode(symbol & 0xffff, &extra, &numExtra);
+		putBits(writer, block->distCodes[code], block->distLengths[code]);
+		putBits(writer, extra, numExtra);
+	}
+
+	putBits(writer, block->litlenCodes[256], block->litlenLengths[256]);
+}
+
+static void writeStored (BitWriter * writer, const uint8_t * data, size_t length, bool last) {
+	do {
+		size_t n = length < STORED_BLOCK ? length : STORED_BLOCK;
+
+		putBits(writer, last && n == length, 1);
+		putBits(writer, 0, 2);
+		alignBits(writer);
+		putBits(writer, n, 16);
+		putBits(writer, ~n & 0xffff, 16);
+
+		memcpy(writer->out, data, n);
+		writer->out += n;
+		data += n;
+		length -= n;
+	} while (length > 0);
+}
+
+// Writes one block of symbols, covering length bytes of data, whichever way
+// comes out shortest.
+static void writeBlock (BitWriter * writer, const uint32_t * symbols, size_t count, const uint8_t * data, size_t length, bool last) {
+	BlockCodes dynamic, fixed;
+	CodeLengths header;
+
+	countSymbols(&dynamic, symbols, count);
+	buildLengths(dynamic.litlenLengths, dynamic.litlenFreqs, NUM_LITLEN, 15);
+	buildLengths(dynamic.distLengths, dynamic.distFreqs, NUM_DIST, 15);
+	buildCodes(dynamic.litlenCodes, dynamic.litlenLengths, NUM_LITLEN);
+	buildCodes(dynamic.distCodes, dynamic.distLengths, NUM_DIST);
+	encodeCodeLengths(&header, &dynamic);
+
+	memcpy(fixed.litlenFreqs, dynamic.litlenFreqs, sizeof(fixed.litlenFreqs));
+	memcpy(fixed.distFreqs, dynamic.distFreqs, sizeof(fixed.distFreqs));
+	fixed.extraBits = dynamic.extraBits;
+	fixedCodes(&fixed);
+
+	uint64_t dynamicBits = 3 + headerBits(&header) + codedBits(&dynamic);
+	uint64_t fixedBits = 3 + codedBits(&fixed);
+	uint64_t storedBits = (length + (length / STORED_BLOCK + 1) * 5) * 8 + 7;
+
+	if (storedBits <= dynamicBits && storedBits <= fixedBits) {
+		writeStored(writer, data, length, last);
+	} else if (fixedBits <= dynamicBits) {
+		putBits(writer, last, 1);
+		putBits(writer, 1, 2);
+		writeSymbols(writer, &fixed, symbols, count);
+	} else {
+		putBits(writer, last, 1);
+		putBits(writer, 2, 2);
+		writeHeader(writer, &header);
+		writeSymbols(writer, &dynamic, symbols, count);
+	}
+}
+
+static uint32_t matchLength (const uint8_t * a, const uint8_t * b, uint32_t limit) {
+	uint32_t n = 0;
+
+	for (; n + 8 <= limit; n += 8) {
+		uint64_t x, y;
+		memcpy(&x, a + n, 8);
+		memcpy(&y, b + n, 8);
+
+		uint64_t diff = le64toh(x) ^ le64toh(y);
+
+		if (diff != 0) {
+			return n + (__builtin_ctzll(diff) >> 3);
+		}
+	}
+
+	while (n < limit && a[n] == b[n]) {
+		n++;
+	}
+
+	return n;
+}
+
+static uint32_t hashAt (const uint8_t * p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return (le32toh(v) * 0x9e3779b1u) >> (32 - HASH_BITS);
+}
+
+// Hash chains through every position inserted so far, the heads by hash
+// and the links by position within the window.
+typedef struct {
+	int32_t * head;
+	int32_t * prev;
+	const MatchLevel * level;
+} Matcher;
+
+static void insertHash (Matcher * matcher, const uint8_t * data, size_t pos) {
+	uint32_t h = hashAt(data + pos);
+	matcher->prev[pos & (WINDOW_SIZE - 1)] = matcher->head[h];
+	matcher->head[h] = pos;
+}
+
+static uint32_t longestMatch (const Matcher * matcher, const uint8_t * data, size_t pos, size_t length, uint32_t * distance) {
+	uint32_t limit = length - pos < MAX_MATCH ? length - pos : MAX_MATCH;
+	uint32_t best = 0;
+	uint32_t chain = matcher->level->maxChain;
+	int32_t candidate = matcher->head[hashAt(data + pos)];
+
+	while (candidate >= 0 && pos - candidate <= WINDOW_SIZE && chain-- > 0) {
+		// a longer match has to get past the best one's last byte
+		if (best < limit && data[candidate + best] == data[pos + best]) {
+			uint32_t n = matchLength(data + candidate, data + pos, limit);
+
+			if (n > best) {
+				best = n;
+				*distance = pos - candidate;
+
+				if (n >= matcher->level->niceLength || n == limit) {
+					break;
+				}
+			}
+		}
+
+		int32_t next = matcher->prev[candidate & (WINDOW_SIZE - 1)];
+
+		// links older than the window have been overwritten by newer ones
+		if (next >= candidate) {
+			break;
+		}
+
+		candidate = next;
+	}
+
+	return best >= MIN_MATCH ? best : 0;
+}
+
+// Runs of whatever came a byte or a pixel before, which is most of what
+// filtered rows of flat color come to.
+static uint32_t longestRun (const uint8_t * data, size_t pos, size_t length, size_t bpp, uint32_t * distance) {
+	uint32_t limit = length - pos < MAX_MATCH ? length - pos : MAX_MATCH;
+	uint32_t best = 0;
+	size_t distances[2] = { 1, bpp };
+
+	for (int i = 0; i < (bpp > 1 ? 2 : 1); i++) {
+		if (pos < distances[i]) {
+			continue;
+		}
+
+		uint32_t n = matchLength(data + pos - distances[i], data + pos, limit);
+
+		if (n > best) {
+			best = n;
+			*distance = distances[i];
+		}
+	}
+
+	return best >= MIN_MATCH ? best : 0;
+}
+
+// Compresses length bytes of data into a raw deflate stream at out, which
+// needs room for the data stored with a few bytes a block, and returns
+// where the stream ends. Without memory to search in, the data still goes
+// out stored.
+static uint8_t * deflate (uint8_t * out, const uint8_t * data, size_t length, size_t bpp, int level) {
+	BitWriter writer = { out, 0, 0 };
+	uint32_t * symbols = NULL;
+	Matcher matcher = { NULL, NULL, &matchLevels[level] };
+
+	if (level > 0) {
+		symbols = malloc(BLOCK_SYMBOLS * sizeof(uint32_t));
+	}
+
+	if (level > 1) {
+		matcher.head = malloc((1 << HASH_BITS) * sizeof(int32_t));
+		matcher.prev = malloc(WINDOW_SIZE * sizeof(int32_t));
+	}
+
+	if (symbols == NULL || (level > 1 && (matcher.head == NULL || matcher.prev == NULL))) {
+		free(symbols);
+		free(matcher.head);
+		free(matcher.prev);
+
+		writeStored(&writer, data, length, true);
+		alignBits(&writer);
+		return writer.out;
+	}
+
+	if (level > 1) {
+		memset(matcher.head, 0xff, (1 << HASH_BITS) * sizeof(int32_t));
+	}
+
+	// the hash reads 4 bytes, so the last few are only ever literals
+	size_t hashEnd = length >= 4 ? length - 3 : 0;
+	size_t count = 0;
+	size_t blockStart = 0;
+	size_t pos = 0;
+
+	while (pos < length) {
+		uint32_t distance = 0;
+		uint32_t match = 0;
+
+		if (pos < hashEnd && level == 1) {
+			match = longestRun(data, pos, length, bpp, &distance);
+		} else if (pos < hashEnd) {
+			match = longestMatch(&matcher, data, pos, length, &distance);
+			insertHash(&matcher, data, pos);
+
+			// a longer match one on is worth a literal first
+			if (match > 0 && matcher.level->lazy && match < matcher.level->niceLength && pos + 1 < hashEnd) {
+				uint32_t nextDistance;
+
+				if (longestMatch(&matcher, data, pos + 1, length, &nextDistance) > match) {
+					match = 0;
+				}
+			}
+		}
+
+		if (match > 0) {
+			symbols[count++] = MATCH_SYMBOL(match, distance);
+
+			for (size_t p = pos + 1; level > 1 && p < pos + match && p < hashEnd; p++) {
+				insertHash(&matcher, data, p);
+			}
+
+			pos += match;
+		} else {
+			symbols[count++] = data[pos++];
+		}
+
+		if (count == BLOCK_SYMBOLS || pos == length) {
+			writeBlock(&writer, symbols, count, data + blockStart, pos - blockStart, pos == length);
+			blockStart = pos;
+			count = 0;
+		}
+	}
+
+	alignBits(&writer);
+
+	free(symbols);
+	free(matcher.head);
+	free(matcher.prev);
+	return writer.out;
+}
+
+// Encodes the texture as a PNG in a buffer of its own, which the caller
+// frees, compressed at a level from 0 to 9. Textures whose size doesn't
+// come to 1 to 4 bytes per pixel can't be written.
+BG3DError encodePNG (const BG3DTexture * texture, BG3DVariant variant, int level, uint8_t ** png, size_t * length) {
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	static const uint8_t colorTypes[5] = { 0, PNG_GRAY, PNG_GRAY_ALPHA, PNG_RGB, PNG_RGBA };
+	static const uint8_t fromARGB[4] = { 1, 2, 3, 0 };
+
+	const BG3DTextureHeader * header = &texture->header;
+	uint64_t numPixels = (uint64_t) header->width * header->height;
+
+	if (texture->pixels == NULL || numPixels == 0 || header->bufferSize % numPixels != 0 ||
+	    header->bufferSize / numPixels < 1 || header->bufferSize / numPixels > 4) {
+		return BG3D_ERROR_STRUCTURE;
+	}
+
+	level = level < 0 ? 0 : level > 9 ? 9 : level;
+
+	size_t channels = header->bufferSize / numPixels;
+	size_t rawLength = header->height * (1 + (size_t) header->width * channels);
+
+	// the signature, IHDR, and IDAT holding the zlib stream, which is never
+	// longer than the rows stored with a few bytes a block, then IEND
+	size_t capacity = 8 + 25 + 12 + 2 + rawLength + rawLength / 4096 + 1024 + 4 + 12;
+
+	const uint8_t * pixels = texture->pixels;
+	uint8_t * converted = NULL;
+
+	if (channels == 4 && variant == BG3D_VARIANT_BOOK) {
+		if ((converted = malloc(header->bufferSize)) == NULL) {
+			return BG3D_ERROR_MEMORY;
+		}
+
+		swizzlePixels(converted, pixels, numPixels, fromARGB);
+		pixels = converted;
+	}
+
+	uint8_t * raw = malloc(rawLength);
+	uint8_t * out = malloc(capacity);
+
+	if (raw == NULL || out == NULL || !filterRows(raw, pixels, header->width, header->height, channels, level)) {
+		free(converted);
+		free(raw);
+		free(out);
+		return BG3D_ERROR_MEMORY;
+	}
+
+	free(converted);
+
+	uint8_t * p = out;
+	memcpy(p, signature, sizeof(signature));
+	p += sizeof(signature);
+
+	uint8_t * chunk = p;
+	p = putU32(p + 4, 0x49484452);
+	p = putU32(p, header->width);
+	p = putU32(p, header->height);
+	*p++ = 8;
+	*p++ = colorTypes[channels];
+	*p++ = 0;
+	*p++ = 0;
+	*p++ = 0;
+	p = endChunk(chunk, p);
+
+	chunk = p;
+	p = putU32(p + 4, 0x49444154);
+
+	// the zlib header, with a hint of how hard the stream was compressed,
+	// then the deflate stream and a checksum of the rows
+	*p++ = 0x78;
+	*p++ = level == 0 ? 0x01 : level < 6 ? 0x5e : level == 6 ? 0x9c : 0xda;
+
+	p = deflate(p, raw, rawLength, channels, level);
+	p = putU32(p, adler32(raw, rawLength));
+	p = endChunk(chunk, p);
+
+	chunk = p;
+	p = putU32(p + 4, 0x49454e44);
+	p = endChunk(chunk, p);
+
+	free(raw);
+
+	*png = out;
+	*length = p - out;
+	return BG3D_OK;
+}
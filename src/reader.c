@@ -0,0 +1,286 @@
+#include <errno.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+
+// Streams are read through a window this big. Only tags and headers are
+// viewed in it; payloads are copied past it, so it never has to grow.
+#define STREAM_WINDOW (64 * 1024)
+
+static const char * errorStrings[] = {
+	"no error",
+	"cannot open file",
+	"file ends early",
+	"not a BG3D file",
+	"unrecognized tag",
+	"tags out of order",
+	"out of memory",
+	"cannot write output",
+	"input cannot seek"
+};
+
+// Sets the reader up to pull from a pipe or anything else that can't be
+// mapped. The descriptor is only closed with the reader if owned is set.
+BG3DError openStreamReader (BG3DReader * pReader, int fd, bool owned) {
+	memset(pReader, 0, sizeof(BG3DReader));
+
+	pReader->fd = fd;
+	pReader->ownsFd = owned;
+	pReader->window = malloc(STREAM_WINDOW);
+
+	if (pReader->window == NULL) {
+		return setError(pReader, BG3D_ERROR_MEMORY, "Error Allocating the Stream Window.");
+	}
+
+	pReader->data = pReader->window;
+	return BG3D_OK;
+}
+
+// Maps regular files and streams everything else, such as named pipes. On
+// failure errno says why the file couldn't be opened.
+BG3DError openReader (BG3DReader * pReader, const char * path) {
+	memset(pReader, 0, sizeof(BG3DReader));
+
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) {
+		return setError(pReader, BG3D_ERROR_OPEN, "Error Opening File.");
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return setError(pReader, BG3D_ERROR_OPEN, "Error Opening File.");
+	}
+
+	if (!S_ISREG(st.st_mode)) {
+		return openStreamReader(pReader, fd, true);
+	}
+
+	if (st.st_size > 0) {
+		void * map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (map == MAP_FAILED) {
+			close(fd);
+			return setError(pReader, BG3D_ERROR_OPEN, "Error Mapping File.");
+		}
+
+		madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+		pReader->data = map;
+		pReader->size = st.st_size;
+	}
+
+	// the mapping keeps its own reference to the file
+	close(fd);
+	return BG3D_OK;
+}
+
+void closeReader (BG3DReader * pReader) {
+	if (pReader->window != NULL) {
+		free(pReader->window);
+
+		if (pReader->ownsFd) {
+			close(pReader->fd);
+		}
+	} else if (pReader->data != NULL) {
+		munmap((void *) pReader->data, pReader->size);
+	}
+
+	pReader->data = NULL;
+	pReader->window = NULL;
+	pReader->size = 0;
+	pReader->pos = 0;
+	pReader->base = 0;
+}
+
+const char * errorString (BG3DError error) {
+	if (error >= sizeof(errorStrings) / sizeof(errorStrings[0])) {
+		return "unknown error";
+	}
+
+	return errorStrings[error];
+}
+
+// Records a failure at the reader's position and passes the error back, so
+// readers can return setError(...) directly. Only the first one is kept.
+BG3DError setError (BG3DReader * pReader, BG3DError error, const char * message) {
+	if (pReader->error == BG3D_OK) {
+		pReader->error = error;
+		pReader->errorMessage = message;
+		pReader->errorOffset = pReader->pos;
+	}
+
+	return error;
+}
+
+// Reads from the stream into dst until at least min bytes arrive or it
+// ends, taking up to max if they are already there. Returns how many bytes
+// were read.
+static size_t readStream (BG3DReader * pReader, uint8_t * dst, size_t min, size_t max) {
+	size_t done = 0;
+
+	while (done < min) {
+		ssize_t n = read(pReader->fd, dst + done, max - done);
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (n <= 0) {
+			break;
+		}
+
+		done += n;
+	}
+
+	return done;
+}
+
+// Makes up to count bytes past the position available in the window,
+// sliding the unread bytes to its start first. Offsets stay those of the
+// whole stream: the window holds the bytes from base to size.
+static void fillWindow (BG3DReader * pReader, size_t count) {
+	size_t unread = pReader->size - pReader->pos;
+
+	if (count > STREAM_WINDOW) {
+		count = STREAM_WINDOW;
+	}
+
+	if (unread >= count) {
+		return;
+	}
+
+	if (pReader->pos + count > pReader->base + STREAM_WINDOW) {
+		memmove(pReader->window, pReader->window + (pReader->pos - pReader->base), unread);
+		pReader->base = pReader->pos;
+	}
+
+	uint8_t * end = pReader->window + (pReader->size - pReader->base);
+	size_t room = STREAM_WINDOW - (pReader->size - pReader->base);
+
+	// take whatever else has arrived too, to keep the number of reads down
+	pReader->size += readStream(pReader, end, count - unread, room);
+}
+
+// Returns how many of the next count bytes can be viewed without moving the
+// position. On a stream that is at most the window, however long it is.
+size_t peekBytes (BG3DReader * pReader, size_t count) {
+	if (pReader->window != NULL) {
+		fillWindow(pReader, count);
+	}
+
+	size_t available = pReader->size - pReader->pos;
+	return available < count ? available : count;
+}
+
+// Returns a view of the next count bytes and advances past them, or NULL if
+// the file ends first. Views into a stream only last until the next read and
+// can't be longer than its window.
+const void * readBytes (BG3DReader * pReader, size_t count) {
+	if (pReader->window != NULL) {
+		fillWindow(pReader, count);
+	}
+
+	if (count > pReader->size - pReader->pos) {
+		return NULL;
+	}
+
+	const void * view = pReader->data + (pReader->pos - pReader->base);
+	pReader->pos += count;
+
+	return view;
+}
+
+// Like readBytes, but for payloads that have to outlive the read. Mapped
+// files still hand out views; streams copy the bytes into the arena, past
+// the window, so payloads of any size can be read from them.
+void * readPayload (BG3DReader * pReader, BG3DArena * arena, size_t count) {
+	if (pReader->window == NULL) {
+		return (void *) readBytes(pReader, count);
+	}
+
+	uint8_t * payload = arenaAlloc(arena, count);
+
+	if (payload == NULL) {
+		setError(pReader, BG3D_ERROR_MEMORY, "Error Allocating a Payload.");
+		return NULL;
+	}
+
+	size_t buffered = pReader->size - pReader->pos;
+	size_t head = buffered < count ? buffered : count;
+
+	memcpy(payload, pReader->window + (pReader->pos - pReader->base), head);
+
+	size_t tail = readStream(pReader, payload + head, count - head, count - head);
+
+	// the window is empty now unless the payload fit in it
+	pReader->pos += head + tail;
+
+	if (pReader->pos > pReader->size) {
+		pReader->size = pReader->base = pReader->pos;
+	}
+
+	return head + tail == count ? payload : NULL;
+}
+
+// Moves the cursor to an absolute offset within the file. Streams can only
+// move within their window.
+bool seekReader (BG3DReader * pReader, size_t pos) {
+	if (pos > pReader->size || pos < pReader->base) {
+		return false;
+	}
+
+	pReader->pos = pos;
+	return true;
+}
+
+// Steps over count bytes without looking at them. On a stream they are read
+// and thrown away a window at a time.
+bool skipBytes (BG3DReader * pReader, size_t count) {
+	if (pReader->window == NULL) {
+		return readBytes(pReader, count) != NULL;
+	}
+
+	while (count > 0) {
+		size_t step = count < STREAM_WINDOW ? count : STREAM_WINDOW;
+
+		if (readBytes(pReader, step) == NULL) {
+			return false;
+		}
+
+		count -= step;
+	}
+
+	return true;
+}
+
+// Only headers will be read from here on, so turn read ahead off; otherwise
+// the kernel would pull in the payloads being skipped anyway.
+void setMetadataOnly (BG3DReader * pReader) {
+	pReader->metadataOnly = true;
+
+	if (pReader->window == NULL && pReader->data != NULL) {
+		madvise((void *) pReader->data, pReader->size, MADV_RANDOM);
+	}
+}
+
+// Reads one big endian 32 bit value.
+bool readU32 (BG3DReader * pReader, uint32_t * value) {
+	const void * view = readBytes(pReader, sizeof(uint32_t));
+
+	if (view == NULL) {
+		return false;
+	}
+
+	memcpy(value, view, sizeof(uint32_t));
+	*value = be32toh(*value);
+
+	return true;
+}
@@ -0,0 +1,316 @@
+#include <string.h>
+
+#include "common.h"
+#include "layout.h"
+
+const char * tagNames[] = {
+	"material flags",
+	"diffuse color",
+	"texture map",
+	"group start",
+	"group end",
+	"geometry",
+	"vertex array",
+	"normal array",
+	"uv array",
+	"color array",
+	"triangle array",
+	"end of file"
+};
+
+static bool addTocEntry (BG3DToc * pToc, long offset, uint32_t tag, uint32_t length) {
+	if (pToc->count == pToc->capacity) {
+		size_t capacity = pToc->capacity ? pToc->capacity * 2 : 32;
+		BG3DTocEntry * entries = realloc(pToc->entries, capacity * sizeof(BG3DTocEntry));
+
+		if (entries == NULL) {
+			return false;
+		}
+
+		pToc->entries = entries;
+		pToc->capacity = capacity;
+	}
+
+	BG3DTocEntry * entry = &pToc->entries[pToc->count++];
+	entry->offset = offset;
+	entry->tag = tag;
+	entry->length = length;
+	entry->index = pToc->tagCounts[tag]++;
+
+	return true;
+}
+
+// Lists every tag's records in the order they come, so findTag can go
+// straight to the nth one.
+static bool indexTags (BG3DToc * pToc) {
+	size_t start = 0;
+
+	pToc->byTag = malloc((pToc->count + 1) * sizeof(size_t));
+
+	if (pToc->byTag == NULL) {
+		return false;
+	}
+
+	for (uint32_t tag = 0; tag <= BG3D_TAGTYPE_ENDFILE; tag++) {
+		pToc->tagStarts[tag] = start;
+		start += pToc->tagCounts[tag];
+	}
+
+	for (size_t i = 0; i < pToc->count; i++) {
+		const BG3DTocEntry * entry = &pToc->entries[i];
+		pToc->byTag[pToc->tagStarts[entry->tag] + entry->index] = i;
+	}
+
+	return true;
+}
+
+// Walks the tag stream from the reader's position to the end of file tag,
+// reading only tags and headers. Payloads are stepped over, so on a mapped
+// file their pages are never touched. The reader position is restored,
+// and on failure the error is recorded at the offending tag.
+BG3DError buildToc (BG3DReader * pReader, BG3DToc * pToc) {
+	BG3DError error = BG3D_ERROR_TRUNCATED;
+	size_t start = pReader->pos;
+	uint32_t numPoints = 0, numTriangles = 0;
+	bool done = false;
+
+	memset(pToc, 0, sizeof(BG3DToc));
+
+	// the walk has to come back to the start, which a stream can't do
+	if (pReader->window != NULL) {
+		return setError(pReader, BG3D_ERROR_SEEK, "Error Indexing BG3D Tags.");
+	}
+
+	pToc->variant = detectVariant(pReader);
+
+	while (!done) {
+		long offset = pReader->pos;
+		uint32_t tag;
+
+		// counts from the file are hostile until checked, so the lengths
+		// they give are worked out wide enough not to wrap
+		uint64_t length;
+
+		if (!readU32(pReader, &tag)) {
+			goto fail;
+		}
+
+		switch (tag) {
+		case BG3D_TAGTYPE_MATERIALFLAGS: {
+			length = 4;
+			break;
+		}
+		case BG3D_TAGTYPE_MATERIALDIFFUSECOLOR: {
+			length = 16;
+			break;
+		}
+		case BG3D_TAGTYPE_TEXTUREMAP: {
+			BG3DTextureHeader header;
+			size_t headerSize = textureHeaderSize(pToc->variant);
+			const void * view = readBytes(pReader, headerSize);
+
+			if (view == NULL) {
+				goto fail;
+			}
+
+			decodeTextureHeader(view, pToc->variant, &header);
+
+			seekReader(pReader, offset + 4);
+
+			length = (uint64_t) headerSize + header.bufferSize;
+			break;
+		}
+		case BG3D_TAGTYPE_GEOMETRY: {
+			BG3DMeshHeader header;
+			size_t headerSize = meshHeaderSize(pToc->variant);
+			const void * view = readBytes(pReader, headerSize);
+
+			if (view == NULL) {
+				goto fail;
+			}
+
+			decodeMeshHeader(view, pToc->variant, &header);
+
+			seekReader(pReader, offset + 4);
+
+			numPoints = header.numPoints;
+			numTriangles = header.numTriangles;
+			length = headerSize;
+			break;
+		}
+		case BG3D_TAGTYPE_VERTEXARRAY:
+		case BG3D_TAGTYPE_NORMALARRAY: {
+			length = (uint64_t) numPoints * 12;
+			break;
+		}
+		case BG3D_TAGTYPE_UVARRAY: {
+			length = (uint64_t) numPoints * 8;
+			break;
+		}
+		case BG3D_TAGTYPE_COLORARRAY: {
+			length = (uint64_t) numPoints * 4;
+			break;
+		}
+		case BG3D_TAGTYPE_TRIANGLEARRAY: {
+			length = (uint64_t) numTriangles * 12;
+			break;
+		}
+		case BG3D_TAGTYPE_GROUPSTART:
+		case BG3D_TAGTYPE_GROUPEND: {
+			length = 0;
+			break;
+		}
+		case BG3D_TAGTYPE_ENDFILE: {
+			length = 0;
+			done = true;
+			break;
+		}
+		default:
+			pReader->pos = offset;
+			error = BG3D_ERROR_BAD_TAG;
+			goto fail;
+		}
+
+		// the entries keep 32 bit lengths, more than any real file needs
+		if (length > UINT32_MAX || readBytes(pReader, length) == NULL) {
+			pReader->pos = offset;
+			goto fail;
+		}
+
+		if (!addTocEntry(pToc, offset, tag, length)) {
+			error = BG3D_ERROR_MEMORY;
+			goto fail;
+		}
+	}
+
+	if (!indexTags(pToc)) {
+		error = BG3D_ERROR_MEMORY;
+		goto fail;
+	}
+
+	seekReader(pReader, start);
+	return BG3D_OK;
+
+fail:
+	setError(pReader, error, "Error Indexing BG3D Tags.");
+	seekReader(pReader, start);
+	free(pToc->entries);
+	memset(pToc, 0, sizeof(BG3DToc));
+	return error;
+}
+
+void freeToc (BG3DToc * pToc) {
+	free(pToc->entries);
+	free(pToc->byTag);
+	memset(pToc, 0, sizeof(BG3DToc));
+}
+
+// Returns the nth record with the given tag, or NULL if there are fewer.
+const BG3DTocEntry * findTag (const BG3DToc * pToc, uint32_t tag, uint32_t n) {
+	if (tag > BG3D_TAGTYPE_ENDFILE || n >= pToc->tagCounts[tag]) {
+		return NULL;
+	}
+
+	return &pToc->entries[pToc->byTag[pToc->tagStarts[tag] + n]];
+}
+
+// Positions the reader at the payload of a record.
+bool seekToTag (BG3DReader * pReader, const BG3DTocEntry * entry) {
+	return seekReader(pReader, entry->offset + 4);
+}
+
+// The headers are read in the file's layout, which the model takes on while
+// it's still empty. After that, records from a file of the other layout
+// would leave its textures in two pixel orders, so they're turned away.
+static BG3DError useTocVariant (BG3DReader * pReader, const BG3DToc * pToc, BG3DModel * model) {
+	// with nothing to tell them apart, either layout reads the file
+	BG3DVariant variant = pToc->variant == BG3D_VARIANT_UNKNOWN ? BG3D_VARIANT_OTTOMATIC : pToc->variant;
+
+	if (model->numMaterials == 0 && model->numMeshes == 0) {
+		model->variant = variant;
+	} else if (model->variant != variant) {
+		return setError(pReader, BG3D_ERROR_STRUCTURE, "Model Holds Another Layout.");
+	}
+
+	return BG3D_OK;
+}
+
+// Decodes texture n on its own and adds it to the model.
+BG3DError parseTextureAt (BG3DReader * pReader, const BG3DToc * pToc, BG3DModel * model, uint32_t n) {
+	const BG3DTocEntry * entry = findTag(pToc, BG3D_TAGTYPE_TEXTUREMAP, n);
+	BG3DError error = useTocVariant(pReader, pToc, model);
+
+	if (error != BG3D_OK) {
+		return error;
+	}
+
+	if (entry == NULL || !seekToTag(pReader, entry)) {
+		return setError(pReader, BG3D_ERROR_STRUCTURE, "No Such Texture.");
+	}
+
+	// textures hang off the material before them
+	if (model->numMaterials == 0 && addMaterial(model) == NULL) {
+		return setError(pReader, BG3D_ERROR_MEMORY, "Error Adding a Material.");
+	}
+
+	return readMaterialTextureMap(pReader, model);
+}
+
+// Decodes mesh n and the arrays that follow its geometry tag, and adds it
+// to the model. The group tags around it aren't read, so it goes in at the
+// top, with its bounds taken straight into the model's.
+BG3DError parseMeshAt (BG3DReader * pReader, const BG3DToc * pToc, BG3DModel * model, uint32_t n) {
+	const BG3DTocEntry * entry = findTag(pToc, BG3D_TAGTYPE_GEOMETRY, n);
+	BG3DError error = useTocVariant(pReader, pToc, model);
+
+	if (error != BG3D_OK) {
+		return error;
+	}
+
+	if (entry == NULL || !seekToTag(pReader, entry)) {
+		return setError(pReader, BG3D_ERROR_STRUCTURE, "No Such Mesh.");
+	}
+
+	if ((error = readNewMesh(pReader, model)) == BG3D_OK) {
+		model->meshes[model->numMeshes - 1].group = -1;
+	}
+
+	for (entry++; entry < pToc->entries + pToc->count && error == BG3D_OK; entry++) {
+		seekToTag(pReader, entry);
+
+		switch (entry->tag) {
+		case BG3D_TAGTYPE_VERTEXARRAY: {
+			error = readVertexArray(pReader, model);
+			continue;
+		}
+		case BG3D_TAGTYPE_NORMALARRAY: {
+			error = readNormalArray(pReader, model);
+			continue;
+		}
+		case BG3D_TAGTYPE_UVARRAY: {
+			error = readUVArray(pReader, model);
+			continue;
+		}
+		case BG3D_TAGTYPE_COLORARRAY: {
+			error = readVertexColorArray(pReader, model);
+			continue;
+		}
+		case BG3D_TAGTYPE_TRIANGLEARRAY: {
+			error = readTriangleArray(pReader, model);
+			continue;
+		}
+		}
+
+		break;
+	}
+
+	return error;
+}
+
+void printToc (const BG3DToc * pToc, FILE * out) {
+	for (size_t i = 0; i < pToc->count; i++) {
+		const BG3DTocEntry * entry = &pToc->entries[i];
+		fprintf(out, "%8lx: %-14s #%-3u 0x%x bytes\n", entry->offset, tagNames[entry->tag],
+		       entry->index, entry->length);
+	}
+}
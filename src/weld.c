@@ -0,0 +1,162 @@
+#include <string.h>
+
+#include "common.h"
+
+// Files often repeat a vertex once for every triangle that uses it. Welding
+// keeps one copy of each distinct vertex, comparing every array bit for bit,
+// and points the triangles at the copies that are left.
+
+// The arrays that make up a vertex, with how many bytes each has per point.
+typedef struct {
+	uint8_t * data[4];
+	size_t size[4];
+	int count;
+} VertexArrays;
+
+static void gatherVertexArrays (BG3DMesh * mesh, VertexArrays * arrays) {
+	arrays->count = 0;
+
+	uint8_t * data[4] = { (uint8_t *) mesh->points, (uint8_t *) mesh->normals, (uint8_t *) mesh->uvs, (uint8_t *) mesh->colors };
+	size_t size[4] = { 12, 12, 8, 4 };
+
+	for (int i = 0; i < 4; i++) {
+		if (data[i] != NULL) {
+			arrays->data[arrays->count] = data[i];
+			arrays->size[arrays->count] = size[i];
+			arrays->count++;
+		}
+	}
+}
+
+// Every array is a whole number of 32 bit words per point.
+static uint32_t hashVertex (const VertexArrays * arrays, uint32_t v) {
+	uint32_t hash = 0x9e3779b9;
+
+	for (int i = 0; i < arrays->count; i++) {
+		const uint8_t * p = arrays->data[i] + v * arrays->size[i];
+
+		for (size_t j = 0; j < arrays->size[i]; j += 4) {
+			uint32_t word;
+			memcpy(&word, p + j, 4);
+
+			hash = (hash ^ word) * 0x85ebca6b;
+			hash ^= hash >> 15;
+		}
+	}
+
+	return hash ^ (hash >> 13);
+}
+
+static bool sameVertex (const VertexArrays * arrays, uint32_t a, uint32_t b) {
+	for (int i = 0; i < arrays->count; i++) {
+		size_t size = arrays->size[i];
+
+		if (memcmp(arrays->data[i] + a * size, arrays->data[i] + b * size, size) != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Welds one mesh in place. The table holds indices of the vertices kept so
+// far, which have already been moved down to their final places.
+static BG3DError weldMesh (BG3DMesh * mesh, BG3DArena * arena) {
+	uint32_t numPoints = mesh->header.numPoints;
+	uint32_t numIndices = mesh->header.numTriangles * 3;
+
+	if (numPoints == 0 || mesh->triangles == NULL) {
+		return BG3D_OK;
+	}
+
+	for (uint32_t i = 0; i < numIndices; i++) {
+		if (mesh->triangles[i] >= numPoints) {
+			return BG3D_ERROR_STRUCTURE;
+		}
+	}
+
+	// colors read from a mapped file are still the file's, which can't be
+	// written, so they get a copy of their own to shrink
+	if (mesh->colors != NULL) {
+		uint8_t * colors = arenaAlloc(arena, (size_t) numPoints * 4);
+
+		if (colors == NULL) {
+			return BG3D_ERROR_MEMORY;
+		}
+
+		memcpy(colors, mesh->colors, (size_t) numPoints * 4);
+		mesh->colors = colors;
+	}
+
+	VertexArrays arrays;
+	gatherVertexArrays(mesh, &arrays);
+
+	// a power of two at least twice the points keeps the probes short
+	size_t tableSize = 16;
+
+	while (tableSize < (size_t) numPoints * 2) {
+		tableSize *= 2;
+	}
+
+	uint32_t * table = malloc(tableSize * sizeof(uint32_t));
+	uint32_t * remap = malloc(numPoints * sizeof(uint32_t));
+
+	if (table == NULL || remap == NULL) {
+		free(table);
+		free(remap);
+		return BG3D_ERROR_MEMORY;
+	}
+
+	memset(table, 0xff, tableSize * sizeof(uint32_t));
+
+	uint32_t numUnique = 0;
+
+	for (uint32_t v = 0; v < numPoints; v++) {
+		size_t slot = hashVertex(&arrays, v) & (tableSize - 1);
+
+		while (table[slot] != UINT32_MAX && !sameVertex(&arrays, table[slot], v)) {
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if (table[slot] != UINT32_MAX) {
+			remap[v] = table[slot];
+			continue;
+		}
+
+		// kept vertices only ever move down, over ones already looked at
+		if (numUnique != v) {
+			for (int i = 0; i < arrays.count; i++) {
+				size_t size = arrays.size[i];
+				memcpy(arrays.data[i] + numUnique * size, arrays.data[i] + v * size, size);
+			}
+		}
+
+		table[slot] = numUnique;
+		remap[v] = numUnique++;
+	}
+
+	for (uint32_t i = 0; i < numIndices; i++) {
+		mesh->triangles[i] = remap[mesh->triangles[i]];
+	}
+
+	mesh->header.numPoints = numUnique;
+
+	free(table);
+	free(remap);
+	return BG3D_OK;
+}
+
+// Welds every mesh in the model. The arrays shrink in place, so the model's
+// memory stays where it is, short of the colors; the bounds are unchanged
+// by it.
+BG3DError weldModel (BG3DModel * model) {
+	for (uint32_t i = 0; i < model->numMeshes; i++) {
+		BG3DError error = weldMesh(&model->meshes[i], &model->arena);
+
+		if (error != BG3D_OK) {
+			return error;
+		}
+	}
+
+	return BG3D_OK;
+}
@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "common.h"
+
+// Decodes the blocks the compressor writes the way a GPU would, from the
+// BC1 and BC3 definitions, and checks what comes back. Blocks made of their
+// own endpoints, or the colors between them, have to come back within the
+// rounding of the interpolation; any color within the 5:6:5 rounding; and
+// gradients closer with cluster fit than with range fit.
+
+static int expand (int value, int bits) {
+	return value << (8 - bits) | value >> (2 * bits - 8);
+}
+
+static void decodeColors (uint8_t texels[16][4], const uint8_t * block, bool alwaysFour) {
+	int c0 = block[0] | block[1] << 8, c1 = block[2] | block[3] << 8;
+	int palette[4][4] = {
+		{ expand(c0 >> 11, 5), expand((c0 >> 5) & 63, 6), expand(c0 & 31, 5), 255 },
+		{ expand(c1 >> 11, 5), expand((c1 >> 5) & 63, 6), expand(c1 & 31, 5), 255 },
+	};
+
+	for (int j = 0; j < 3; j++) {
+		if (c0 > c1 || alwaysFour) {
+			palette[2][j] = (2 * palette[0][j] + palette[1][j]) / 3;
+			palette[3][j] = (palette[0][j] + 2 * palette[1][j]) / 3;
+		} else {
+			palette[2][j] = (palette[0][j] + palette[1][j]) / 2;
+			palette[3][j] = 0;
+		}
+	}
+
+	palette[2][3] = 255;
+	palette[3][3] = c0 > c1 || alwaysFour ? 255 : 0;
+
+	for (int i = 0; i < 16; i++) {
+		int index = (block[4 + i / 4] >> (2 * (i % 4))) & 3;
+
+		for (int j = 0; j < 4; j++) {
+			texels[i][j] = palette[index][j];
+		}
+	}
+}
+
+static void decodeAlphas (uint8_t texels[16][4], const uint8_t * block) {
+	int a0 = block[0], a1 = block[1];
+	int palette[8] = { a0, a1, 0, 0, 0, 0, 0, 255 };
+
+	if (a0 > a1) {
+		for (int i = 1; i < 7; i++) {
+			palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+		}
+	} else {
+		for (int i = 1; i < 5; i++) {
+			palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+		}
+	}
+
+	uint64_t indices = 0;
+
+	for (int i = 0; i < 6; i++) {
+		indices |= (uint64_t) block[2 + i] << (8 * i);
+	}
+
+	for (int i = 0; i < 16; i++) {
+		texels[i][3] = palette[(indices >> (3 * i)) & 7];
+	}
+}
+
+// Decodes a width by height level of blocks back into RGBA pixels.
+static void decodeLevel (uint8_t * pixels, const uint8_t * blocks, uint32_t width, uint32_t height, bool alpha) {
+	uint32_t blocksWide = (width + 3) / 4;
+
+	for (uint32_t by = 0; by < (height + 3) / 4; by++) {
+		for (uint32_t bx = 0; bx < blocksWide; bx++) {
+			const uint8_t * block = blocks + ((size_t) by * blocksWide + bx) * (alpha ? 16 : 8);
+			uint8_t texels[16][4];
+
+			decodeColors(texels, alpha ? block + 8 : block, alpha);
+
+			if (alpha) {
+				decodeAlphas(texels, block);
+			}
+
+			for (uint32_t i = 0; i < 16; i++) {
+				uint32_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+
+				if (x < width && y < height) {
+					memcpy(pixels + ((size_t) y * width + x) * 4, texels[i], 4);
+				}
+			}
+		}
+	}
+}
+
+// Compresses and decodes the level, and returns the largest difference in
+// each channel, and the sum of their squares.
+static uint64_t roundTrip (const uint8_t * pixels, uint32_t width, uint32_t height, bool alpha, BG3DBlockCompression fit, int * worst) {
+	size_t numBlocks = (size_t) ((width + 3) / 4) * ((height + 3) / 4);
+	size_t numPixels = (size_t) width * height;
+	uint8_t * blocks = malloc(numBlocks * (alpha ? 16 : 8));
+	uint8_t * decoded = malloc(numPixels * 4);
+	uint64_t error = 0;
+
+	compressBlocks(blocks, pixels, width, height, alpha, fit, 1);
+	decodeLevel(decoded, blocks, width, height, alpha);
+
+	memset(worst, 0, 4 * sizeof(int));
+
+	for (size_t i = 0; i < numPixels * 4; i++) {
+		int difference = abs(decoded[i] - pixels[i]);
+		worst[i % 4] = difference > worst[i % 4] ? difference : worst[i % 4];
+		error += difference * difference;
+	}
+
+	free(blocks);
+	free(decoded);
+	return error;
+}
+
+// A random color that 5:6:5 holds exactly.
+static void randomEndpoint (uint8_t * color) {
+	color[0] = expand(rand() % 32, 5);
+	color[1] = expand(rand() % 64, 6);
+	color[2] = expand(rand() % 32, 5);
+}
+
+static const char * fitNames[3] = { "none", "range", "cluster" };
+
+// Blocks of two endpoints, or of their four colors, with alphas of their
+// eight: only the interpolation's rounding is lost, which hardware may do
+// either way for alpha.
+static void testEndpoints (void) {
+	uint8_t pixels[16 * 4];
+
+	srand(1);
+
+	for (int alpha = 0; alpha < 2; alpha++) {
+		for (int fit = BG3D_BLOCKS_RANGE_FIT; fit <= BG3D_BLOCKS_CLUSTER_FIT; fit++) {
+			for (int steps = 2; steps <= 4; steps += 2) {
+				for (int n = 0; n < 500; n++) {
+					uint8_t ends[2][4];
+					randomEndpoint(ends[0]);
+					randomEndpoint(ends[1]);
+					ends[0][3] = alpha ? rand() : 255;
+					ends[1][3] = alpha ? rand() : 255;
+
+					for (int i = 0; i < 16; i++) {
+						// texel 0 and 15 hold the endpoints themselves
+						int t = i == 0 ? 0 : i == 15 ? steps - 1 : rand() % steps;
+						int u = i == 0 ? 0 : i == 15 ? 7 : rand() % 8;
+
+						for (int j = 0; j < 3; j++) {
+							pixels[i * 4 + j] = (ends[0][j] * (steps - 1 - t) + ends[1][j] * t + (steps - 1) / 2) / (steps - 1);
+						}
+
+						pixels[i * 4 + 3] = (ends[0][3] * (7 - u) + ends[1][3] * u + 3) / 7;
+					}
+
+					int worst[4];
+					roundTrip(pixels, 4, 4, alpha, fit, worst);
+
+					int tolerance = steps == 2 ? 0 : 1;
+					CHECK(worst[0] <= tolerance && worst[1] <= tolerance && worst[2] <= tolerance,
+					      "%s fit, %d steps: colors off by %d %d %d", fitNames[fit], steps, worst[0], worst[1], worst[2]);
+					CHECK(worst[3] <= 1, "%s fit, %d steps: alpha off by %d", fitNames[fit], steps, worst[3]);
+				}
+			}
+		}
+	}
+}
+
+// One color anywhere in the cube, in a level whose edge blocks are only
+// partly covered, comes back within the 5:6:5 rounding. Alphas of 0 and
+// 255 among others stay exact.
+static void testFlat (void) {
+	uint8_t pixels[7 * 5 * 4];
+
+	srand(2);
+
+	for (int alpha = 0; alpha < 2; alpha++) {
+		for (int n = 0; n < 500; n++) {
+			uint8_t color[4] = { rand(), rand(), rand(), alpha ? rand() : 255 };
+
+			for (size_t i = 0; i < sizeof(pixels); i += 4) {
+				memcpy(pixels + i, color, 4);
+
+				// a cutout's edge
+				if (alpha && i % 12 == 0) {
+					pixels[i + 3] = i % 24 == 0 ? 0 : 255;
+				}
+			}
+
+			int worst[4];
+			roundTrip(pixels, 7, 5, alpha, BG3D_BLOCKS_CLUSTER_FIT, worst);
+
+			CHECK(worst[0] <= 4 && worst[1] <= 2 && worst[2] <= 4, "%02x%02x%02x: off by %d %d %d", color[0], color[1], color[2],
+			      worst[0], worst[1], worst[2]);
+			CHECK(worst[3] <= 1, "alpha %u beside 0 and 255: off by %d", color[3], worst[3]);
+		}
+	}
+}
+
+// Gradients between arbitrary colors, across and down the level, come
+// back within a step of the four colors, and closer with cluster fit.
+static void testGradients (void) {
+	uint32_t width = 64, height = 64;
+	uint8_t * pixels = malloc(width * height * 4);
+
+	srand(3);
+
+	for (int alpha = 0; alpha < 2; alpha++) {
+		uint64_t errors[3] = { 0 };
+		int worst[3][4];
+
+		for (int n = 0; n < 20; n++) {
+			uint8_t ends[2][4] = { { rand(), rand(), rand(), rand() }, { rand(), rand(), rand(), rand() } };
+
+			for (uint32_t y = 0; y < height; y++) {
+				for (uint32_t x = 0; x < width; x++) {
+					// one block's worth of the way from one end to the other
+					float t = ((x + y) % 8) / 7.0f;
+					uint8_t * p = pixels + ((size_t) y * width + x) * 4;
+
+					for (int j = 0; j < 4; j++) {
+						p[j] = (uint8_t) (ends[0][j] + (ends[1][j] - ends[0][j]) * t + 0.5f);
+					}
+
+					p[3] = alpha ? p[3] : 255;
+				}
+			}
+
+			for (int fit = BG3D_BLOCKS_RANGE_FIT; fit <= BG3D_BLOCKS_CLUSTER_FIT; fit++) {
+				errors[fit] += roundTrip(pixels, width, height, alpha, fit, worst[fit]);
+
+				for (int j = 0; j < 3; j++) {
+					int range = abs(ends[1][j] - ends[0][j]);
+					CHECK(worst[fit][j] <= range / 6 + 6, "%s fit: channel %d off by %d across %d", fitNames[fit], j, worst[fit][j], range);
+				}
+
+				int range = abs(ends[1][3] - ends[0][3]);
+				CHECK(worst[fit][3] <= range / 14 + 2, "%s fit: alpha off by %d across %d", fitNames[fit], worst[fit][3], range);
+			}
+		}
+
+		CHECK(errors[BG3D_BLOCKS_CLUSTER_FIT] <= errors[BG3D_BLOCKS_RANGE_FIT], "cluster fit is further off, %llu to %llu",
+		      (unsigned long long) errors[BG3D_BLOCKS_CLUSTER_FIT], (unsigned long long) errors[BG3D_BLOCKS_RANGE_FIT]);
+	}
+
+	free(pixels);
+}
+
+// However many threads share a level out, it comes out the same.
+static void testThreads (void) {
+	uint32_t width = 256, height = 130;
+	size_t numPixels = (size_t) width * height;
+	size_t length = (size_t) (width / 4) * ((height + 3) / 4) * 16;
+	uint8_t * pixels = malloc(numPixels * 4);
+	uint8_t * one = malloc(length);
+	uint8_t * several = malloc(length);
+
+	srand(4);
+
+	for (size_t i = 0; i < numPixels * 4; i++) {
+		pixels[i] = rand() % 64 + i / (width * 4) % 128;
+	}
+
+	compressBlocks(one, pixels, width, height, true, BG3D_BLOCKS_RANGE_FIT, 1);
+	compressBlocks(several, pixels, width, height, true, BG3D_BLOCKS_RANGE_FIT, 5);
+	CHECK(memcmp(one, several, length) == 0, "blocks differ between one thread and five");
+
+	free(pixels);
+	free(one);
+	free(several);
+}
+
+int main (void) {
+	testEndpoints();
+	testFlat();
+	testGradients();
+	testThreads();
+
+	return failures != 0;
+}
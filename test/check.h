@@ -0,0 +1,21 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+// The tests are plain programs: each check that fails is logged with where
+// it is, and main returns how many did, so make check stops on the first
+// program with any.
+
+static int failures = 0;
+
+#define CHECK(condition, ...) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+		fprintf(stderr, __VA_ARGS__); \
+		fputc('\n', stderr); \
+		failures++; \
+	} \
+} while (0)
+
+#endif /* CHECK_H */
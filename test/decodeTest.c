@@ -0,0 +1,198 @@
+#include <stdlib.h>
+
+#include "check.h"
+
+// The kernels are static, so the decoder is built in here whole to get at
+// them.
+#include "decode.c"
+
+// Each vector kernel the CPU can run is checked against the scalar one, on
+// every count up to a few blocks past its width, so the tails take every
+// length short of a block, from unaligned starts and in place. The point
+// kernels also have to come to the same bounds, NaNs and all.
+
+// The CPU check only takes a literal, so it's looked up by name here.
+static bool cpuSupports (const char * feature) {
+#ifdef DECODE_X86
+	__builtin_cpu_init();
+
+	if (feature != NULL && strcmp(feature, "ssse3") == 0) {
+		return __builtin_cpu_supports("ssse3");
+	}
+
+	if (feature != NULL && strcmp(feature, "avx2") == 0) {
+		return __builtin_cpu_supports("avx2");
+	}
+#endif // DECODE_X86
+
+	return feature == NULL;
+}
+
+typedef struct {
+	const char * name;
+	const char * feature;
+	void (*decode) (void *, const void *, size_t);
+} SwapKernel;
+
+typedef struct {
+	const char * name;
+	const char * feature;
+	void (*decode) (void *, const void *, size_t, BG3DBounds *);
+} PointsKernel;
+
+static void testBigEndian32 (void) {
+	static const SwapKernel kernels[] = {
+		{ "scalar", NULL, decodeBigEndian32Scalar },
+#ifdef DECODE_X86
+		{ "ssse3", "ssse3", decodeBigEndian32SSSE3 },
+		{ "avx2", "avx2", decodeBigEndian32AVX2 },
+#endif // DECODE_X86
+	};
+
+	uint8_t data[80 * 4 + 3], expected[80 * 4], out[80 * 4 + 4];
+
+	srand(1);
+
+	for (size_t i = 0; i < sizeof(data); i++) {
+		data[i] = rand();
+	}
+
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+		if (!cpuSupports(kernels[k].feature)) {
+			printf("decodeTest: no %s here, so its kernels aren't checked\n", kernels[k].name);
+			continue;
+		}
+
+		for (size_t offset = 0; offset < 4; offset++) {
+			for (size_t count = 0; count <= 80; count++) {
+				for (size_t i = 0; i < count * 4; i++) {
+					expected[i] = data[offset + (i & ~(size_t) 3) + 3 - i % 4];
+				}
+
+				// the byte past the end has to be left alone
+				memset(out, 0xa5, sizeof(out));
+				kernels[k].decode(out + 3 - offset, data + offset, count);
+				CHECK(memcmp(out + 3 - offset, expected, count * 4) == 0 && out[3 - offset + count * 4] == 0xa5,
+				      "%s byte swap of %zu values at %zu", kernels[k].name, count, offset);
+
+				memcpy(out, data + offset, count * 4);
+				kernels[k].decode(out, out, count);
+				CHECK(memcmp(out, expected, count * 4) == 0, "%s byte swap of %zu values in place", kernels[k].name, count);
+			}
+		}
+	}
+
+	decodeBigEndian32Scalar(expected, data, 80);
+	decodeBigEndian32(out, data, 80);
+	CHECK(memcmp(out, expected, 80 * 4) == 0, "selected byte swap kernel");
+}
+
+// Points from a small range, a third of them NaNs, infinities or zeros of
+// either sign, so NaNs come after every lane's extremes often enough to
+// show a kernel that lets one through. Stored big endian, as in the file.
+static void fillPoints (uint8_t * data, size_t count) {
+	static const float specials[] = { __builtin_nanf(""), __builtin_inff(), -__builtin_inff(), -0.0f, 0.0f };
+
+	for (size_t i = 0; i < count; i++) {
+		float v = rand() % 3 == 0 ? specials[rand() % 5] : (rand() % 2001 - 1000) / 8.0f;
+		uint32_t bits;
+
+		memcpy(&bits, &v, 4);
+		bits = htobe32(bits);
+		memcpy(data + i * 4, &bits, 4);
+	}
+}
+
+// Starting from no bounds, and from bounds another mesh left that some of
+// the points fall outside of.
+static void startBounds (BG3DBounds * bounds, int preset) {
+	for (int j = 0; j < 3; j++) {
+		bounds->min[j] = preset ? -50.0f * j : __builtin_inff();
+		bounds->max[j] = preset ? 20.0f * j : -__builtin_inff();
+	}
+}
+
+static bool sameBounds (const BG3DBounds * a, const BG3DBounds * b) {
+	for (int j = 0; j < 3; j++) {
+		if (a->min[j] != b->min[j] || a->max[j] != b->max[j]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void testPoints (void) {
+	static const PointsKernel kernels[] = {
+		{ "scalar", NULL, decodePointsScalar },
+#ifdef DECODE_X86
+		{ "ssse3", "ssse3", decodePointsSSSE3 },
+		{ "avx2", "avx2", decodePointsAVX2 },
+#endif // DECODE_X86
+	};
+
+	// the source is read unaligned, but the output is floats the kernels
+	// read back, so it stays aligned
+	uint8_t data[40 * 12 + 3], expected[40 * 12];
+	float out[40 * 3 + 1];
+
+	srand(2);
+	fillPoints(data, sizeof(data) / 4);
+
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+		if (!cpuSupports(kernels[k].feature)) {
+			continue;
+		}
+
+		for (size_t offset = 0; offset < 4; offset++) {
+			for (size_t numPoints = 0; numPoints <= 40; numPoints++) {
+				for (int preset = 0; preset < 2; preset++) {
+					BG3DBounds wanted, bounds;
+					startBounds(&wanted, preset);
+					startBounds(&bounds, preset);
+
+					// the bounds the scalar kernel has to come to, worked out
+					// straight from the swapped values
+					decodeBigEndian32Scalar(expected, data + offset, numPoints * 3);
+
+					for (size_t i = 0; i < numPoints * 3; i++) {
+						float v;
+						memcpy(&v, expected + i * 4, 4);
+
+						if (v == v) {
+							wanted.min[i % 3] = v < wanted.min[i % 3] ? v : wanted.min[i % 3];
+							wanted.max[i % 3] = v > wanted.max[i % 3] ? v : wanted.max[i % 3];
+						}
+					}
+
+					memset(out, 0xa5, sizeof(out));
+					kernels[k].decode(out, data + offset, numPoints, &bounds);
+					CHECK(memcmp(out, expected, numPoints * 12) == 0 && ((uint8_t *) out)[numPoints * 12] == 0xa5,
+					      "%s decode of %zu points at %zu", kernels[k].name, numPoints, offset);
+					CHECK(sameBounds(&bounds, &wanted), "%s bounds of %zu points at %zu, %s", kernels[k].name, numPoints, offset,
+					      preset ? "preset" : "empty");
+
+					startBounds(&bounds, preset);
+					memcpy(out, data + offset, numPoints * 12);
+					kernels[k].decode(out, out, numPoints, &bounds);
+					CHECK(memcmp(out, expected, numPoints * 12) == 0 && sameBounds(&bounds, &wanted),
+					      "%s decode of %zu points in place", kernels[k].name, numPoints);
+				}
+			}
+		}
+	}
+
+	BG3DBounds wanted, bounds;
+	startBounds(&wanted, 0);
+	startBounds(&bounds, 0);
+	decodePointsScalar(expected, data, 40, &wanted);
+	decodePoints(out, data, 40, &bounds);
+	CHECK(memcmp(out, expected, 40 * 12) == 0 && sameBounds(&bounds, &wanted), "selected point kernel");
+}
+
+int main (void) {
+	testBigEndian32();
+	testPoints();
+
+	return failures != 0;
+}
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+
+#include "check.h"
+
+// The kernels are static, so the encoder is built in here whole to get at
+// them.
+#include "encode.c"
+
+// Each vector kernel the CPU can run is checked against what the scalar
+// ones are documented to do, on every count up to a few blocks past its
+// width, so the tails take every length short of a block. Inputs are
+// allocated to their exact size, so a sanitizer build catches any kernel
+// reading past the end.
+
+// The CPU check only takes a literal, so it's looked up by name here.
+static bool cpuSupports (const char * feature) {
+#ifdef ENCODE_X86
+	__builtin_cpu_init();
+
+	if (feature != NULL && strcmp(feature, "ssse3") == 0) {
+		return __builtin_cpu_supports("ssse3");
+	}
+
+	if (feature != NULL && strcmp(feature, "sse4.1") == 0) {
+		return __builtin_cpu_supports("sse4.1");
+	}
+
+	if (feature != NULL && strcmp(feature, "avx2") == 0) {
+		return __builtin_cpu_supports("avx2");
+	}
+#endif // ENCODE_X86
+
+	return feature == NULL;
+}
+
+typedef struct {
+	const char * name;
+	const char * feature;
+	void (*narrow16) (uint16_t *, const uint32_t *, size_t);
+	void (*narrow8) (uint8_t *, const uint32_t *, size_t);
+} NarrowKernel;
+
+typedef struct {
+	const char * name;
+	const char * feature;
+	void (*convert) (uint8_t *, const uint8_t *, size_t, const uint8_t *);
+	size_t size;
+} PixelKernel;
+
+// Indices up to the largest the narrow type holds, which is where a pack
+// that saturates as signed would go wrong.
+static void testNarrow (void) {
+	static const NarrowKernel kernels[] = {
+		{ "scalar", NULL, narrowIndices16Scalar, narrowIndices8Scalar },
+#ifdef ENCODE_X86
+		{ "sse4.1", "sse4.1", narrowIndices16SSE41, narrowIndices8SSE41 },
+		{ "avx2", "avx2", narrowIndices16AVX2, narrowIndices8AVX2 },
+#endif // ENCODE_X86
+	};
+
+	srand(1);
+
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+		if (!cpuSupports(kernels[k].feature)) {
+			printf("encodeTest: no %s here, so its kernels aren't checked\n", kernels[k].name);
+			continue;
+		}
+
+		for (size_t count = 0; count <= 100; count++) {
+			uint32_t * src16 = malloc(count * 4);
+			uint32_t * src8 = malloc(count * 4);
+			uint16_t * dst16 = malloc(count * 2 + 2);
+			uint8_t * dst8 = malloc(count + 1);
+
+			for (size_t i = 0; i < count; i++) {
+				src16[i] = rand() % 2 ? 0xffff - rand() % 4 : rand() % 0x10000;
+				src8[i] = rand() % 2 ? 0xff - rand() % 4 : rand() % 0x100;
+			}
+
+			dst16[count] = 0xa5a5;
+			dst8[count] = 0xa5;
+			kernels[k].narrow16(dst16, src16, count);
+			kernels[k].narrow8(dst8, src8, count);
+
+			bool same16 = dst16[count] == 0xa5a5, same8 = dst8[count] == 0xa5;
+
+			for (size_t i = 0; i < count; i++) {
+				same16 = same16 && dst16[i] == src16[i];
+				same8 = same8 && dst8[i] == src8[i];
+			}
+
+			CHECK(same16, "%s narrowing of %zu indices to 16 bits", kernels[k].name, count);
+			CHECK(same8, "%s narrowing of %zu indices to 8 bits", kernels[k].name, count);
+
+			if (count == 100) {
+				narrowIndices16(dst16, src16, count);
+				narrowIndices8(dst8, src8, count);
+
+				for (size_t i = 0; i < count; i++) {
+					same16 = same16 && dst16[i] == src16[i];
+					same8 = same8 && dst8[i] == src8[i];
+				}
+
+				CHECK(same16 && same8, "selected narrowing kernels");
+			}
+
+			free(src16);
+			free(src8);
+			free(dst16);
+			free(dst8);
+		}
+	}
+}
+
+// The orders the textures use, and a few that repeat or drop channels.
+static void testPixels (void) {
+	static const PixelKernel kernels[] = {
+		{ "scalar swizzle", NULL, swizzlePixelsScalar, 4 },
+		{ "scalar expand", NULL, expandPixelsScalar, 3 },
+#ifdef ENCODE_X86
+		{ "ssse3 swizzle", "ssse3", swizzlePixelsSSSE3, 4 },
+		{ "ssse3 expand", "ssse3", expandPixelsSSSE3, 3 },
+		{ "avx2 swizzle", "avx2", swizzlePixelsAVX2, 4 },
+#endif // ENCODE_X86
+	};
+
+	static const uint8_t orders[][4] = { { 0, 1, 2, 3 }, { 1, 2, 3, 0 }, { 2, 1, 0, 3 }, { 3, 2, 1, 0 }, { 0, 0, 0, 2 }, { 2, 2, 1, 1 } };
+
+	srand(2);
+
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+		if (!cpuSupports(kernels[k].feature)) {
+			continue;
+		}
+
+		size_t size = kernels[k].size;
+
+		for (size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); o++) {
+			// three byte pixels have no byte 3 to take
+			if (size == 3 && (orders[o][0] == 3 || orders[o][1] == 3 || orders[o][2] == 3)) {
+				continue;
+			}
+
+			for (size_t count = 0; count <= 40; count++) {
+				uint8_t * src = malloc(count * size);
+				uint8_t * dst = malloc(count * 4 + 1);
+				uint8_t * expected = malloc(count * 4 + 1);
+
+				for (size_t i = 0; i < count * size; i++) {
+					src[i] = rand();
+				}
+
+				for (size_t i = 0; i < count; i++) {
+					for (int c = 0; c < 4; c++) {
+						expected[i * 4 + c] = c == 3 && size == 3 ? 0xff : src[i * size + orders[o][c]];
+					}
+				}
+
+				dst[count * 4] = 0xa5;
+				kernels[k].convert(dst, src, count, orders[o]);
+				CHECK(memcmp(dst, expected, count * 4) == 0 && dst[count * 4] == 0xa5, "%s of %zu pixels to %u%u%u%u",
+				      kernels[k].name, count, orders[o][0], orders[o][1], orders[o][2], orders[o][3]);
+
+				if (count == 40) {
+					memset(dst, 0, count * 4);
+					(size == 4 ? swizzlePixels : expandPixels)(dst, src, count, orders[o]);
+					CHECK(memcmp(dst, expected, count * 4) == 0, "selected %s kernel", size == 4 ? "swizzle" : "expand");
+				}
+
+				free(src);
+				free(dst);
+				free(expected);
+			}
+		}
+	}
+}
+
+int main (void) {
+	testNarrow();
+	testPixels();
+
+	return failures != 0;
+}
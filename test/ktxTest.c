@@ -0,0 +1,338 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "common.h"
+
+// Reads the KTX2 files the encoder writes back the way the specification
+// lays them out: the header, the data format descriptor, the one key and
+// the level index, with every level where the index says, aligned to its
+// texel blocks, smallest first and ending the file. Uncompressed levels
+// have to hold the texture's pixels in RGBA order, and mip levels the
+// average of the ones above them.
+
+typedef struct {
+	uint32_t vkFormat;
+	uint32_t blockBytes;
+	uint32_t blockSide;
+	uint32_t colorModel;
+	uint32_t numSamples;
+} Format;
+
+// RGBA8, BC1 and BC3, all sRGB.
+static const Format formats[3] = {
+	{ 43, 4, 1, 1, 4 },
+	{ 132, 8, 4, 128, 1 },
+	{ 138, 16, 4, 130, 2 },
+};
+
+static uint32_t le32 (const uint8_t * p) {
+	return (uint32_t) p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static uint64_t le64 (const uint8_t * p) {
+	return le32(p) | (uint64_t) le32(p + 4) << 32;
+}
+
+// Checks the sample at p describes bitLength bits of channel at bitOffset,
+// with upper as its largest value.
+static void checkSample (const uint8_t * p, uint32_t bitOffset, uint32_t bitLength, uint32_t channel, uint32_t upper, const char * name) {
+	CHECK(le32(p) == (bitOffset | (bitLength - 1) << 16 | channel << 24), "%s: sample at bit %u", name, bitOffset);
+	CHECK(le32(p + 4) == 0 && le32(p + 8) == 0, "%s: sample at bit %u has a position or lower bound", name, bitOffset);
+	CHECK(le32(p + 12) == upper, "%s: sample at bit %u goes up to %u", name, bitOffset, le32(p + 12));
+}
+
+// Checks the file's layout, and returns the offset of each level, or 0 for
+// the ones it couldn't find.
+static void checkLayout (const uint8_t * ktx, size_t length, uint32_t width, uint32_t height, uint32_t numLevels, const Format * format,
+                         const char * name, size_t * offsets) {
+	static const uint8_t identifier[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+
+	memset(offsets, 0, numLevels * sizeof(size_t));
+
+	if (length < 80 + 24 * numLevels) {
+		CHECK(false, "%s: only %zu bytes", name, length);
+		return;
+	}
+
+	CHECK(memcmp(ktx, identifier, 12) == 0, "%s: identifier", name);
+	CHECK(le32(ktx + 12) == format->vkFormat, "%s: format %u", name, le32(ktx + 12));
+	CHECK(le32(ktx + 16) == 1, "%s: type size %u", name, le32(ktx + 16));
+	CHECK(le32(ktx + 20) == width && le32(ktx + 24) == height, "%s: %ux%u", name, le32(ktx + 20), le32(ktx + 24));
+	CHECK(le32(ktx + 28) == 0 && le32(ktx + 32) == 0 && le32(ktx + 36) == 1, "%s: depth, layers or faces", name);
+	CHECK(le32(ktx + 40) == numLevels, "%s: %u levels", name, le32(ktx + 40));
+	CHECK(le32(ktx + 44) == 0, "%s: supercompressed", name);
+
+	// the descriptor and key come straight after the level index
+	uint32_t dfdOffset = le32(ktx + 48), dfdLength = le32(ktx + 52);
+	uint32_t kvdOffset = le32(ktx + 56), kvdLength = le32(ktx + 60);
+
+	CHECK(dfdOffset == 80 + 24 * numLevels, "%s: descriptor at %u", name, dfdOffset);
+	CHECK(dfdLength == 28 + 16 * format->numSamples, "%s: descriptor of %u bytes", name, dfdLength);
+	CHECK(kvdOffset == dfdOffset + dfdLength && kvdLength == 24, "%s: key and value at %u, %u bytes", name, kvdOffset, kvdLength);
+	CHECK(le64(ktx + 64) == 0 && le64(ktx + 72) == 0, "%s: supercompression data", name);
+
+	if (kvdOffset + kvdLength > length) {
+		CHECK(false, "%s: key and value past the end", name);
+		return;
+	}
+
+	const uint8_t * dfd = ktx + dfdOffset;
+	CHECK(le32(dfd) == dfdLength, "%s: descriptor says it's %u bytes", name, le32(dfd));
+	CHECK(le32(dfd + 4) == 0, "%s: descriptor vendor or type", name);
+	CHECK(le32(dfd + 8) == (2 | (dfdLength - 4) << 16), "%s: descriptor version or size", name);
+	CHECK(le32(dfd + 12) == (format->colorModel | 1 << 8 | 2 << 16), "%s: color model, primaries, transfer or flags", name);
+	CHECK(le32(dfd + 16) == ((format->blockSide - 1) | (format->blockSide - 1) << 8), "%s: block dimensions", name);
+	CHECK(le32(dfd + 20) == format->blockBytes && le32(dfd + 24) == 0, "%s: bytes per plane", name);
+
+	if (format->vkFormat == 43) {
+		for (uint32_t i = 0; i < 3; i++) {
+			checkSample(dfd + 28 + 16 * i, 8 * i, 8, i, 255, name);
+		}
+
+		checkSample(dfd + 76, 24, 8, 15 | 0x10, 255, name);
+	} else if (format->vkFormat == 132) {
+		checkSample(dfd + 28, 0, 64, 0, UINT32_MAX, name);
+	} else {
+		checkSample(dfd + 28, 0, 64, 15 | 0x10, UINT32_MAX, name);
+		checkSample(dfd + 44, 64, 64, 0, UINT32_MAX, name);
+	}
+
+	const uint8_t * kvd = ktx + kvdOffset;
+	CHECK(le32(kvd) == 18 && memcmp(kvd + 4, "KTXwriter\0libbg3d\0\0\0", 20) == 0, "%s: writer", name);
+
+	// smallest first, each aligned and straight after the last, the first
+	// after the key and the biggest ending the file
+	size_t end = kvdOffset + kvdLength;
+
+	for (uint32_t i = numLevels; i-- > 0;) {
+		const uint8_t * level = ktx + 80 + 24 * i;
+		uint32_t levelWidth = width >> i ? width >> i : 1;
+		uint32_t levelHeight = height >> i ? height >> i : 1;
+		uint64_t levelLength = (uint64_t) ((levelWidth + format->blockSide - 1) / format->blockSide) *
+		                       ((levelHeight + format->blockSide - 1) / format->blockSide) * format->blockBytes;
+		uint64_t offset = le64(level);
+		uint64_t padded = (end + format->blockBytes - 1) / format->blockBytes * format->blockBytes;
+
+		CHECK(offset == padded, "%s: level %u at %llu, not %llu", name, i, (unsigned long long) offset, (unsigned long long) padded);
+		CHECK(le64(level + 8) == levelLength && le64(level + 16) == levelLength, "%s: level %u is %llu bytes, not %llu", name, i,
+		      (unsigned long long) le64(level + 8), (unsigned long long) levelLength);
+
+		if (offset < end || offset + levelLength > length) {
+			CHECK(false, "%s: level %u overlaps or runs off the end", name, i);
+			return;
+		}
+
+		offsets[i] = offset;
+		end = offset + levelLength;
+	}
+
+	CHECK(end == length, "%s: %zu bytes after the levels", name, length - end);
+}
+
+static BG3DTexture makeTexture (const uint8_t * pixels, uint32_t width, uint32_t height, size_t channels) {
+	BG3DTexture texture = {
+		.header = {
+			.width = width,
+			.height = height,
+			.bufferSize = width * height * channels,
+		},
+		.pixels = pixels,
+	};
+
+	return texture;
+}
+
+// Every size of pixel, in either variant's order, with and without mips, on
+// sizes that are odd, not square, and down to a single pixel.
+static void testRGBA (void) {
+	static const uint32_t sizes[][2] = { { 1, 1 }, { 2, 1 }, { 13, 5 }, { 16, 16 }, { 3, 40 } };
+	static const uint8_t fromARGB[4] = { 1, 2, 3, 0 };
+
+	srand(1);
+
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		uint32_t width = sizes[s][0], height = sizes[s][1];
+		size_t numPixels = (size_t) width * height;
+		uint32_t numLevels = 1;
+
+		while ((width | height) >> numLevels) {
+			numLevels++;
+		}
+
+		for (size_t channels = 1; channels <= 4; channels++) {
+			for (int book = 0; book < 2; book++) {
+				for (int mipmaps = 0; mipmaps < 2; mipmaps++) {
+					uint8_t * source = malloc(numPixels * channels);
+					uint8_t * expected = malloc(numPixels * 4);
+					char name[64];
+
+					snprintf(name, sizeof(name), "%ux%u at %zu bytes%s%s", width, height, channels, book ? ", book" : "",
+					         mipmaps ? ", mipmapped" : "");
+
+					for (size_t i = 0; i < numPixels * channels; i++) {
+						source[i] = rand();
+					}
+
+					for (size_t i = 0; i < numPixels; i++) {
+						const uint8_t * p = source + i * channels;
+						uint8_t * e = expected + i * 4;
+
+						if (channels <= 2) {
+							e[0] = e[1] = e[2] = p[0];
+							e[3] = channels == 2 ? p[1] : 255;
+						} else if (channels == 3) {
+							memcpy(e, p, 3);
+							e[3] = 255;
+						} else {
+							for (int c = 0; c < 4; c++) {
+								e[c] = p[book ? fromARGB[c] : c];
+							}
+						}
+					}
+
+					BG3DTexture texture = makeTexture(source, width, height, channels);
+					BG3DVariant variant = book ? BG3D_VARIANT_BOOK : BG3D_VARIANT_OTTOMATIC;
+					uint8_t * ktx = NULL;
+					size_t length = 0;
+					size_t offsets[32];
+
+					CHECK(encodeKTX2(&texture, variant, mipmaps, BG3D_BLOCKS_NONE, 1, &ktx, &length) == BG3D_OK, "%s: doesn't encode", name);
+
+					if (ktx != NULL) {
+						uint32_t levels = mipmaps ? numLevels : 1;
+						checkLayout(ktx, length, width, height, levels, &formats[0], name, offsets);
+						CHECK(offsets[0] == 0 || memcmp(ktx + offsets[0], expected, numPixels * 4) == 0, "%s: pixels differ", name);
+					}
+
+					free(source);
+					free(expected);
+					free(ktx);
+				}
+			}
+		}
+	}
+}
+
+// A flat color stays the same color all the way down, and black beside
+// white averages to half the light, which sRGB stores as 188, not 128.
+static void testMipmaps (void) {
+	uint8_t flat[12 * 7 * 4];
+
+	for (size_t i = 0; i < sizeof(flat); i += 4) {
+		memcpy(flat + i, (uint8_t[4]) { 200, 90, 17, 160 }, 4);
+	}
+
+	BG3DTexture texture = makeTexture(flat, 12, 7, 4);
+	uint8_t * ktx = NULL;
+	size_t length = 0;
+	size_t offsets[32];
+
+	CHECK(encodeKTX2(&texture, BG3D_VARIANT_OTTOMATIC, true, BG3D_BLOCKS_NONE, 1, &ktx, &length) == BG3D_OK, "flat color doesn't encode");
+
+	if (ktx != NULL) {
+		checkLayout(ktx, length, 12, 7, 4, &formats[0], "flat color", offsets);
+
+		for (uint32_t i = 1; i < 4 && offsets[i] != 0; i++) {
+			size_t numPixels = (size_t) (12 >> i) * (7 >> i ? 7 >> i : 1);
+
+			for (size_t p = 0; p < numPixels * 4; p++) {
+				CHECK(abs(ktx[offsets[i] + p] - flat[p]) <= 1, "flat color: level %u, byte %zu is %u, not %u", i, p, ktx[offsets[i] + p], flat[p]);
+			}
+		}
+
+		free(ktx);
+	}
+
+	uint8_t halves[8] = { 0, 0, 0, 255, 255, 255, 255, 255 };
+	texture = makeTexture(halves, 2, 1, 4);
+	ktx = NULL;
+
+	CHECK(encodeKTX2(&texture, BG3D_VARIANT_OTTOMATIC, true, BG3D_BLOCKS_NONE, 1, &ktx, &length) == BG3D_OK, "black and white doesn't encode");
+
+	if (ktx != NULL) {
+		checkLayout(ktx, length, 2, 1, 2, &formats[0], "black and white", offsets);
+
+		if (offsets[1] != 0) {
+			const uint8_t * p = ktx + offsets[1];
+			CHECK(abs(p[0] - 188) <= 1 && p[0] == p[1] && p[1] == p[2] && p[3] == 255, "black and white average to %u %u %u %u", p[0], p[1], p[2], p[3]);
+		}
+
+		free(ktx);
+	}
+}
+
+// Opaque textures go in BC1 blocks, the rest in BC3, and levels smaller
+// than a block still take a whole one.
+static void testBlockLayout (void) {
+	static const uint32_t sizes[][2] = { { 1, 1 }, { 4, 4 }, { 13, 5 }, { 64, 32 } };
+
+	srand(2);
+
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		uint32_t width = sizes[s][0], height = sizes[s][1];
+		size_t numPixels = (size_t) width * height;
+		uint32_t numLevels = 1;
+
+		while ((width | height) >> numLevels) {
+			numLevels++;
+		}
+
+		for (int alpha = 0; alpha < 2; alpha++) {
+			for (int fit = BG3D_BLOCKS_RANGE_FIT; fit <= BG3D_BLOCKS_CLUSTER_FIT; fit++) {
+				uint8_t * source = malloc(numPixels * 4);
+				char name[64];
+
+				snprintf(name, sizeof(name), "%ux%u %s, %s fit", width, height, alpha ? "BC3" : "BC1", fit == BG3D_BLOCKS_RANGE_FIT ? "range" : "cluster");
+
+				for (size_t i = 0; i < numPixels * 4; i++) {
+					source[i] = i % 4 == 3 && !alpha ? 255 : rand();
+				}
+
+				BG3DTexture texture = makeTexture(source, width, height, 4);
+				uint8_t * ktx = NULL;
+				size_t length = 0;
+				size_t offsets[32];
+
+				CHECK(encodeKTX2(&texture, BG3D_VARIANT_OTTOMATIC, true, fit, 2, &ktx, &length) == BG3D_OK, "%s: doesn't encode", name);
+
+				if (ktx != NULL) {
+					checkLayout(ktx, length, width, height, numLevels, &formats[alpha ? 2 : 1], name, offsets);
+				}
+
+				free(source);
+				free(ktx);
+			}
+		}
+	}
+}
+
+// Pixels that don't come to 1 to 4 bytes each can't be written.
+static void testRejects (void) {
+	uint8_t pixels[5 * 4 * 4] = { 0 };
+	uint8_t * ktx = NULL;
+	size_t length = 0;
+
+	BG3DTexture texture = makeTexture(pixels, 4, 4, 5);
+	CHECK(encodeKTX2(&texture, BG3D_VARIANT_OTTOMATIC, false, BG3D_BLOCKS_NONE, 1, &ktx, &length) == BG3D_ERROR_STRUCTURE,
+	      "5 bytes per pixel encoded");
+
+	texture = makeTexture(pixels, 4, 4, 4);
+	texture.header.bufferSize = 63;
+	CHECK(encodeKTX2(&texture, BG3D_VARIANT_OTTOMATIC, false, BG3D_BLOCKS_NONE, 1, &ktx, &length) == BG3D_ERROR_STRUCTURE,
+	      "uneven buffer size encoded");
+
+	texture = makeTexture(pixels, 0, 4, 4);
+	CHECK(encodeKTX2(&texture, BG3D_VARIANT_OTTOMATIC, false, BG3D_BLOCKS_NONE, 1, &ktx, &length) == BG3D_ERROR_STRUCTURE,
+	      "empty texture encoded");
+	CHECK(ktx == NULL, "rejected texture left a file");
+}
+
+int main (void) {
+	testRGBA();
+	testMipmaps();
+	testBlockLayout();
+	testRejects();
+
+	return failures != 0;
+}
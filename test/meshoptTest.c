@@ -0,0 +1,381 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "common.h"
+
+// Round trips through decoders written from the EXT_meshopt_compression
+// specification, apart from the encoders, so a stream that only the
+// encoder's own idea of the format accepts still fails.
+
+#define CANARY 0xcd
+
+// What the index decoder met on the way, so the tests can tell the paths
+// they mean to cover were taken.
+typedef struct {
+	int resets;
+	int fec13;
+	int fec14;
+} IndexCodes;
+
+static uint32_t readIndex (const uint8_t ** data, uint32_t last) {
+	uint32_t v = 0;
+
+	for (int shift = 0; ; shift += 7) {
+		uint8_t byte = *(*data)++;
+		v |= (uint32_t) (byte & 127) << shift;
+
+		if (byte < 128) {
+			break;
+		}
+	}
+
+	return last + ((v >> 1) ^ -(v & 1));
+}
+
+// Decodes a version 1 index stream, returning false if it runs over the
+// length given or doesn't end exactly at its table.
+static bool decodeIndices (uint32_t * out, size_t count, const uint8_t * stream, size_t length, IndexCodes * codes) {
+	uint32_t edges[16][2], vertices[16];
+	size_t edgeOffset = 0, vertexOffset = 0;
+	uint32_t next = 0, last = 0;
+
+	memset(edges, 0xff, sizeof(edges));
+	memset(vertices, 0xff, sizeof(vertices));
+	memset(codes, 0, sizeof(IndexCodes));
+
+	if (length < 1 + count / 3 + 16 || stream[0] != 0xe1) {
+		return false;
+	}
+
+	const uint8_t * code = stream + 1;
+	const uint8_t * data = code + count / 3;
+	const uint8_t * table = stream + length - 16;
+
+	#define PUSH_VERTEX(v) (vertices[vertexOffset] = (v), vertexOffset = (vertexOffset + 1) & 15)
+	#define PUSH_EDGE(a, b) (edges[edgeOffset][0] = (a), edges[edgeOffset][1] = (b), edgeOffset = (edgeOffset + 1) & 15)
+
+	for (size_t i = 0; i < count; i += 3) {
+		uint8_t c0 = *code++;
+		uint32_t a, b, c;
+
+		if (data > table) {
+			return false;
+		}
+
+		if (c0 < 0xf0) {
+			int fe = c0 >> 4, fec = c0 & 15;
+
+			a = edges[(edgeOffset - 1 - fe) & 15][0];
+			b = edges[(edgeOffset - 1 - fe) & 15][1];
+
+			if (fec == 0) {
+				c = next++;
+				PUSH_VERTEX(c);
+			} else if (fec < 13) {
+				c = vertices[(vertexOffset - 1 - fec) & 15];
+			} else {
+				codes->fec13 += fec == 13;
+				codes->fec14 += fec == 14;
+				c = last = fec == 15 ? readIndex(&data, last) : fec == 13 ? last - 1 : last + 1;
+				PUSH_VERTEX(c);
+			}
+
+			PUSH_EDGE(c, b);
+			PUSH_EDGE(a, c);
+		} else {
+			int fea, feb, fec;
+
+			if (c0 < 0xfe) {
+				fea = 0;
+				feb = table[c0 & 15] >> 4;
+				fec = table[c0 & 15] & 15;
+			} else {
+				uint8_t aux = *data++;
+				fea = c0 == 0xfe ? 0 : 15;
+				feb = aux >> 4;
+				fec = aux & 15;
+
+				if (aux == 0) {
+					codes->resets++;
+					next = 0;
+				}
+			}
+
+			a = fea == 0 ? next++ : 0;
+			b = feb == 0 ? next++ : vertices[(vertexOffset - feb) & 15];
+			c = fec == 0 ? next++ : vertices[(vertexOffset - fec) & 15];
+
+			if (fea == 15) {
+				a = last = readIndex(&data, last);
+			}
+
+			if (feb == 15) {
+				b = last = readIndex(&data, last);
+			}
+
+			if (fec == 15) {
+				c = last = readIndex(&data, last);
+			}
+
+			PUSH_VERTEX(a);
+
+			if (feb == 0 || feb == 15) {
+				PUSH_VERTEX(b);
+			}
+
+			if (fec == 0 || fec == 15) {
+				PUSH_VERTEX(c);
+			}
+
+			PUSH_EDGE(b, a);
+			PUSH_EDGE(c, b);
+			PUSH_EDGE(a, c);
+		}
+
+		out[i] = a;
+		out[i + 1] = b;
+		out[i + 2] = c;
+	}
+
+	#undef PUSH_VERTEX
+	#undef PUSH_EDGE
+
+	return data == table;
+}
+
+// Whether two triangles are the same up to which corner comes first.
+static bool sameTriangle (const uint32_t * a, const uint32_t * b) {
+	for (int r = 0; r < 3; r++) {
+		if (a[0] == b[r] && a[1] == b[(r + 1) % 3] && a[2] == b[(r + 2) % 3]) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Encodes the indices into a buffer of exactly the bound, then checks the
+// stream stayed inside it and decodes back to the same triangles.
+static size_t roundTripIndices (const char * name, const uint32_t * indices, size_t count, IndexCodes * codes) {
+	size_t bound = indexStreamBound(count);
+	uint8_t * stream = malloc(bound + 16);
+	uint32_t * decoded = malloc((count + 1) * sizeof(uint32_t));
+
+	memset(stream, CANARY, bound + 16);
+
+	size_t length = encodeIndexStream(stream, indices, count);
+
+	CHECK(length <= bound, "%s: %zu bytes is over the bound of %zu", name, length, bound);
+
+	for (size_t i = bound; i < bound + 16; i++) {
+		CHECK(stream[i] == CANARY, "%s: written past the bound at %zu", name, i);
+	}
+
+	CHECK(decodeIndices(decoded, count, stream, length, codes), "%s: stream doesn't decode", name);
+
+	for (size_t i = 0; i < count; i += 3) {
+		CHECK(sameTriangle(indices + i, decoded + i), "%s: triangle %zu is %u %u %u, not %u %u %u", name, i / 3,
+		      decoded[i], decoded[i + 1], decoded[i + 2], indices[i], indices[i + 1], indices[i + 2]);
+	}
+
+	free(stream);
+	free(decoded);
+	return length;
+}
+
+static void testIndexPaths (void) {
+	IndexCodes codes;
+
+	// a strip, then the same strip again as a second joined mesh, which
+	// starts over at 0, 1, 2
+	uint32_t joined[] = { 0, 1, 2, 2, 1, 3, 2, 3, 4, 0, 1, 2, 2, 1, 3 };
+	roundTripIndices("reset", joined, 15, &codes);
+	CHECK(codes.resets == 1, "reset: %d reset codes, not 1", codes.resets);
+
+	// triangles off an edge whose new corner is one past, then one before,
+	// the last index written out
+	uint32_t neighbours[] = { 0, 1, 2, 2, 1, 10, 10, 1, 11, 11, 1, 20, 20, 1, 19 };
+	roundTripIndices("fec", neighbours, 15, &codes);
+	CHECK(codes.fec14 == 1, "fec: %d codes of 14, not 1", codes.fec14);
+	CHECK(codes.fec13 == 1, "fec: %d codes of 13, not 1", codes.fec13);
+}
+
+// Every index far from the last one written and in no FIFO, so each
+// triangle takes a code, an extra byte and three five byte indices.
+static void testIndexBound (void) {
+	size_t count = 3 * 64;
+	uint32_t * indices = malloc(count * sizeof(uint32_t));
+	IndexCodes codes;
+
+	for (size_t i = 0; i < count; i++) {
+		indices[i] = i % 2 ? 1000 + i : 0x80000000u + i;
+	}
+
+	size_t length = roundTripIndices("bound", indices, count, &codes);
+	CHECK(length == indexStreamBound(count), "bound: worst case took %zu bytes, not %zu", length, indexStreamBound(count));
+
+	free(indices);
+}
+
+// A mesh of the sort files hold, a grid of quads, as random triangles too.
+static void testIndexMeshes (void) {
+	size_t side = 40, count = (side - 1) * (side - 1) * 6;
+	uint32_t * indices = malloc(count * sizeof(uint32_t));
+	IndexCodes codes;
+	size_t n = 0;
+
+	for (uint32_t y = 0; y + 1 < side; y++) {
+		for (uint32_t x = 0; x + 1 < side; x++) {
+			uint32_t v = y * side + x;
+			uint32_t quad[6] = { v, v + side, v + 1, v + 1, v + side, v + side + 1 };
+			memcpy(indices + n, quad, sizeof(quad));
+			n += 6;
+		}
+	}
+
+	size_t length = roundTripIndices("grid", indices, count, &codes);
+	CHECK(length < count, "grid: %zu bytes for %zu indices is no compression", length, count);
+
+	srand(1);
+
+	for (size_t i = 0; i < count; i++) {
+		indices[i] = rand() % 300;
+	}
+
+	roundTripIndices("random", indices, count, &codes);
+	roundTripIndices("empty", indices, 0, &codes);
+	free(indices);
+}
+
+static const uint8_t * decodeGroup (const uint8_t * data, uint8_t * out, int mode) {
+	static const int widths[4] = { 0, 2, 4, 8 };
+	int bits = widths[mode];
+
+	if (bits == 0) {
+		memset(out, 0, 16);
+		return data;
+	}
+
+	if (bits == 8) {
+		memcpy(out, data, 16);
+		return data + 16;
+	}
+
+	const uint8_t * extra = data + 16 * bits / 8;
+	uint8_t sentinel = (1 << bits) - 1;
+
+	for (int i = 0; i < 16; i++) {
+		uint8_t value = (data[i * bits / 8] >> (8 - bits - (i * bits) % 8)) & sentinel;
+		out[i] = value == sentinel ? *extra++ : value;
+	}
+
+	return extra;
+}
+
+// Decodes a version 0 vertex stream, returning false if it doesn't end
+// exactly at its tail.
+static bool decodeVertices (uint8_t * out, size_t count, size_t stride, const uint8_t * stream, size_t length) {
+	size_t tailSize = stride < 32 ? 32 : stride;
+	size_t blockSize = (8192 / stride) & ~(size_t) 15;
+	uint8_t last[256], bytes[256];
+
+	blockSize = blockSize < 256 ? blockSize : 256;
+
+	if (length < 1 + tailSize || stream[0] != 0xa0) {
+		return false;
+	}
+
+	const uint8_t * data = stream + 1;
+	const uint8_t * tail = stream + length - tailSize;
+
+	memcpy(last, stream + length - stride, stride);
+
+	for (size_t start = 0; start < count; start += blockSize) {
+		size_t n = count - start < blockSize ? count - start : blockSize;
+		size_t groups = (n + 15) / 16;
+
+		for (size_t k = 0; k < stride; k++) {
+			const uint8_t * header = data;
+			data += (groups + 3) / 4;
+
+			for (size_t g = 0; g < groups; g++) {
+				data = decodeGroup(data, bytes + g * 16, (header[g / 4] >> ((g % 4) * 2)) & 3);
+			}
+
+			if (data > tail) {
+				return false;
+			}
+
+			uint8_t previous = last[k];
+
+			for (size_t i = 0; i < n; i++) {
+				previous += (bytes[i] >> 1) ^ -(bytes[i] & 1);
+				out[(start + i) * stride + k] = previous;
+			}
+
+			last[k] = previous;
+		}
+	}
+
+	return data == tail;
+}
+
+static void roundTripVertices (const char * name, const uint8_t * vertices, size_t count, size_t stride) {
+	size_t bound = vertexStreamBound(count, stride);
+	uint8_t * stream = malloc(bound + 16);
+	uint8_t * decoded = malloc(count * stride + 1);
+
+	memset(stream, CANARY, bound + 16);
+
+	size_t length = encodeVertexStream(stream, vertices, count, stride);
+
+	CHECK(length <= bound, "%s: %zu vertices of %zu bytes took %zu, over the bound of %zu", name, count, stride, length, bound);
+
+	for (size_t i = bound; i < bound + 16; i++) {
+		CHECK(stream[i] == CANARY, "%s: %zu vertices of %zu bytes written past the bound", name, count, stride);
+	}
+
+	CHECK(decodeVertices(decoded, count, stride, stream, length) && memcmp(decoded, vertices, count * stride) == 0,
+	      "%s: %zu vertices of %zu bytes don't decode to themselves", name, count, stride);
+
+	free(stream);
+	free(decoded);
+}
+
+// Smooth data packs into every group width, noise into none, across block
+// and group edges and the strides the exporter uses.
+static void testVertices (void) {
+	static const size_t counts[] = { 0, 1, 15, 16, 17, 255, 256, 257, 700, 2049 };
+	static const size_t strides[] = { 4, 8, 12, 16, 20, 64, 256 };
+
+	size_t most = 2049 * 256;
+	uint8_t * smooth = malloc(most);
+	uint8_t * noise = malloc(most);
+
+	srand(2);
+
+	for (size_t i = 0; i < most; i++) {
+		smooth[i] = (uint8_t) (i / 97 + (i % 7 == 0 ? rand() % 40 : 0));
+		noise[i] = rand();
+	}
+
+	for (size_t s = 0; s < sizeof(strides) / sizeof(strides[0]); s++) {
+		for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+			roundTripVertices("smooth", smooth, counts[c], strides[s]);
+			roundTripVertices("noise", noise, counts[c], strides[s]);
+		}
+	}
+
+	free(smooth);
+	free(noise);
+}
+
+int main (void) {
+	testIndexPaths();
+	testIndexBound();
+	testIndexMeshes();
+	testVertices();
+
+	return failures != 0;
+}
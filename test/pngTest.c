@@ -0,0 +1,571 @@
+#include <stdlib.h>
+
+#include "check.h"
+
+// The kernels are static, so the encoder is built in here whole to get at
+// them.
+#include "png.c"
+
+// Decodes every PNG the encoder writes with an inflater written from RFC
+// 1951, along the lines of zlib's puff, and checks the rows come back as
+// the texture's pixels. The CRC kernels are checked against a CRC worked
+// out a bit at a time.
+
+static uint32_t bitwiseCrc (uint32_t crc, const uint8_t * data, size_t length) {
+	crc = ~crc;
+
+	for (size_t i = 0; i < length; i++) {
+		crc ^= data[i];
+
+		for (int k = 0; k < 8; k++) {
+			crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+		}
+	}
+
+	return ~crc;
+}
+
+typedef struct {
+	const uint8_t * in;
+	size_t length;
+	size_t pos;
+	uint32_t bits;
+	int numBits;
+	uint8_t * out;
+	size_t outLength;
+	size_t outPos;
+	bool failed;
+} Inflater;
+
+typedef struct {
+	short count[16];
+	short symbol[288];
+} Huffman;
+
+static uint32_t getBits (Inflater * s, int n) {
+	uint32_t bits = s->bits;
+
+	while (s->numBits < n) {
+		if (s->pos == s->length) {
+			s->failed = true;
+			return 0;
+		}
+
+		bits |= (uint32_t) s->in[s->pos++] << s->numBits;
+		s->numBits += 8;
+	}
+
+	s->bits = bits >> n;
+	s->numBits -= n;
+	return bits & ((1u << n) - 1);
+}
+
+// Canonical codes from their lengths. As in zlib, a set that doesn't use
+// up every code is only allowed if it's a single code of one bit, or empty.
+static bool buildHuffman (Huffman * h, const short * lengths, int n) {
+	short offsets[16];
+	int left = 1;
+
+	memset(h->count, 0, sizeof(h->count));
+
+	for (int i = 0; i < n; i++) {
+		h->count[lengths[i]]++;
+	}
+
+	if (h->count[0] == n) {
+		return true;
+	}
+
+	for (int length = 1; length < 16; length++) {
+		left = (left << 1) - h->count[length];
+
+		if (left < 0) {
+			return false;
+		}
+	}
+
+	if (left > 0 && !(n - h->count[0] == 1 && h->count[1] == 1)) {
+		return false;
+	}
+
+	offsets[1] = 0;
+
+	for (int length = 1; length < 15; length++) {
+		offsets[length + 1] = offsets[length] + h->count[length];
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (lengths[i] != 0) {
+			h->symbol[offsets[lengths[i]]++] = i;
+		}
+	}
+
+	return true;
+}
+
+static int decodeSymbol (Inflater * s, const Huffman * h) {
+	int code = 0, first = 0, index = 0;
+
+	for (int length = 1; length < 16; length++) {
+		code |= getBits(s, 1);
+
+		if (code - h->count[length] < first) {
+			return h->symbol[index + code - first];
+		}
+
+		index += h->count[length];
+		first = (first + h->count[length]) << 1;
+		code <<= 1;
+	}
+
+	s->failed = true;
+	return -1;
+}
+
+static bool inflateCodes (Inflater * s, const Huffman * lengthCodes, const Huffman * distanceCodes) {
+	static const short lengthBase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+	};
+	static const short lengthExtra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+	};
+	static const short distanceBase[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+		6145, 8193, 12289, 16385, 24577
+	};
+	static const short distanceExtra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+	};
+
+	for (;;) {
+		int symbol = decodeSymbol(s, lengthCodes);
+
+		if (s->failed) {
+			return false;
+		}
+
+		if (symbol == 256) {
+			return true;
+		}
+
+		if (symbol < 256) {
+			if (s->outPos == s->outLength) {
+				return false;
+			}
+
+			s->out[s->outPos++] = symbol;
+			continue;
+		}
+
+		if ((symbol -= 257) >= 29) {
+			return false;
+		}
+
+		size_t length = lengthBase[symbol] + getBits(s, lengthExtra[symbol]);
+		int d = decodeSymbol(s, distanceCodes);
+
+		if (d < 0 || d >= 30) {
+			return false;
+		}
+
+		size_t distance = distanceBase[d] + getBits(s, distanceExtra[d]);
+
+		if (s->failed || distance > s->outPos || length > s->outLength - s->outPos) {
+			return false;
+		}
+
+		for (size_t i = 0; i < length; i++, s->outPos++) {
+			s->out[s->outPos] = s->out[s->outPos - distance];
+		}
+	}
+}
+
+static bool inflateStored (Inflater * s) {
+	s->bits = 0;
+	s->numBits = 0;
+
+	if (s->length - s->pos < 4) {
+		return false;
+	}
+
+	size_t length = s->in[s->pos] | s->in[s->pos + 1] << 8;
+	size_t inverse = s->in[s->pos + 2] | s->in[s->pos + 3] << 8;
+	s->pos += 4;
+
+	if (length != (~inverse & 0xffff) || s->length - s->pos < length || s->outLength - s->outPos < length) {
+		return false;
+	}
+
+	memcpy(s->out + s->outPos, s->in + s->pos, length);
+	s->pos += length;
+	s->outPos += length;
+	return true;
+}
+
+static bool inflateFixed (Inflater * s) {
+	Huffman lengthCodes, distanceCodes;
+	short lengths[288];
+
+	for (int i = 0; i < 288; i++) {
+		lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+	}
+
+	buildHuffman(&lengthCodes, lengths, 288);
+
+	for (int i = 0; i < 30; i++) {
+		lengths[i] = 5;
+	}
+
+	// thirty of the thirty two codes are used, so the set is incomplete
+	// and has to be built without the check
+	memset(distanceCodes.count, 0, sizeof(distanceCodes.count));
+	distanceCodes.count[5] = 30;
+
+	for (int i = 0; i < 30; i++) {
+		distanceCodes.symbol[i] = i;
+	}
+
+	return inflateCodes(s, &lengthCodes, &distanceCodes);
+}
+
+static bool inflateDynamic (Inflater * s) {
+	static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	Huffman lengthCodes, distanceCodes;
+	short lengths[320] = { 0 };
+
+	int numLengths = getBits(s, 5) + 257;
+	int numDistances = getBits(s, 5) + 1;
+	int numCodes = getBits(s, 4) + 4;
+
+	if (numLengths > 286 || numDistances > 30) {
+		return false;
+	}
+
+	for (int i = 0; i < numCodes; i++) {
+		lengths[order[i]] = getBits(s, 3);
+	}
+
+	if (s->failed || !buildHuffman(&lengthCodes, lengths, 19)) {
+		return false;
+	}
+
+	for (int i = 0; i < numLengths + numDistances;) {
+		int symbol = decodeSymbol(s, &lengthCodes);
+		int repeat;
+		short length = 0;
+
+		if (s->failed) {
+			return false;
+		}
+
+		if (symbol < 16) {
+			lengths[i++] = symbol;
+			continue;
+		}
+
+		if (symbol == 16) {
+			if (i == 0) {
+				return false;
+			}
+
+			length = lengths[i - 1];
+			repeat = 3 + getBits(s, 2);
+		} else if (symbol == 17) {
+			repeat = 3 + getBits(s, 3);
+		} else {
+			repeat = 11 + getBits(s, 7);
+		}
+
+		if (i + repeat > numLengths + numDistances) {
+			return false;
+		}
+
+		while (repeat-- > 0) {
+			lengths[i++] = length;
+		}
+	}
+
+	if (lengths[256] == 0 || !buildHuffman(&lengthCodes, lengths, numLengths) ||
+	    !buildHuffman(&distanceCodes, lengths + numLengths, numDistances)) {
+		return false;
+	}
+
+	return inflateCodes(s, &lengthCodes, &distanceCodes);
+}
+
+// Inflates a zlib stream into out, which has to come out exactly full,
+// with the stream and its checksum ending right at the end of the data.
+static bool inflateZlib (uint8_t * out, size_t outLength, const uint8_t * in, size_t length) {
+	Inflater s = { .in = in, .length = length, .pos = 2, .out = out, .outLength = outLength };
+	bool last;
+
+	if (length < 6 || (in[0] & 15) != 8 || (in[0] << 8 | in[1]) % 31 != 0 || (in[1] & 0x20)) {
+		return false;
+	}
+
+	do {
+		last = getBits(&s, 1);
+		bool ok;
+
+		switch (getBits(&s, 2)) {
+		case 0:
+			ok = inflateStored(&s);
+			break;
+		case 1:
+			ok = inflateFixed(&s);
+			break;
+		case 2:
+			ok = inflateDynamic(&s);
+			break;
+		default:
+			ok = false;
+		}
+
+		if (!ok || s.failed) {
+			return false;
+		}
+	} while (!last);
+
+	uint32_t a = 1, b = 0;
+
+	for (size_t i = 0; i < outLength; i++) {
+		a = (a + out[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+
+	const uint8_t * check = in + s.pos;
+
+	return s.outPos == outLength && s.pos + 4 == length &&
+	       ((uint32_t) check[0] << 24 | check[1] << 16 | check[2] << 8 | check[3]) == (b << 16 | a);
+}
+
+static uint32_t bigEndian32 (const uint8_t * p) {
+	return (uint32_t) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+// Undoes the row filters in place, leaving the rows one after another
+// without their filter bytes.
+static bool unfilterRows (uint8_t * pixels, const uint8_t * raw, size_t width, size_t height, size_t bpp) {
+	size_t rowSize = width * bpp;
+
+	for (size_t y = 0; y < height; y++) {
+		const uint8_t * in = raw + y * (rowSize + 1);
+		uint8_t * row = pixels + y * rowSize;
+		const uint8_t * prev = y > 0 ? row - rowSize : NULL;
+
+		for (size_t x = 0; x < rowSize; x++) {
+			int a = x >= bpp ? row[x - bpp] : 0;
+			int b = prev != NULL ? prev[x] : 0;
+			int c = x >= bpp && prev != NULL ? prev[x - bpp] : 0;
+			int p = a + b - c, predicted;
+
+			switch (in[0]) {
+			case FILTER_NONE: predicted = 0; break;
+			case FILTER_SUB: predicted = a; break;
+			case FILTER_UP: predicted = b; break;
+			case FILTER_AVERAGE: predicted = (a + b) / 2; break;
+			case FILTER_PAETH: {
+				int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+				predicted = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+				break;
+			}
+			default:
+				return false;
+			}
+
+			row[x] = in[1 + x] + predicted;
+		}
+	}
+
+	return true;
+}
+
+// Reads the PNG back, checking every chunk's CRC, and returns its pixels,
+// or NULL if anything about it is off.
+static uint8_t * decodePNG (const uint8_t * png, size_t length, uint32_t width, uint32_t height, size_t channels) {
+	static const uint8_t colorTypes[5] = { 0, PNG_GRAY, PNG_GRAY_ALPHA, PNG_RGB, PNG_RGBA };
+
+	uint8_t * idat = malloc(length);
+	size_t idatLength = 0;
+	size_t pos = 8;
+	bool ended = false, headed = false;
+
+	if (length < 8 || memcmp(png, "\x89PNG\r\n\x1a\n", 8) != 0) {
+		free(idat);
+		return NULL;
+	}
+
+	while (!ended && length - pos >= 12) {
+		uint32_t chunkLength = bigEndian32(png + pos);
+		const uint8_t * type = png + pos + 4;
+		const uint8_t * data = png + pos + 8;
+
+		if (chunkLength > length - pos - 12 || bigEndian32(data + chunkLength) != bitwiseCrc(0, type, chunkLength + 4)) {
+			break;
+		}
+
+		if (memcmp(type, "IHDR", 4) == 0) {
+			headed = chunkLength == 13 && bigEndian32(data) == width && bigEndian32(data + 4) == height && data[8] == 8 &&
+			         data[9] == colorTypes[channels] && data[10] == 0 && data[11] == 0 && data[12] == 0;
+		} else if (memcmp(type, "IDAT", 4) == 0) {
+			memcpy(idat + idatLength, data, chunkLength);
+			idatLength += chunkLength;
+		} else if (memcmp(type, "IEND", 4) == 0) {
+			ended = chunkLength == 0 && pos + 12 == length;
+		}
+
+		pos += 12 + chunkLength;
+	}
+
+	size_t rawLength = height * (1 + width * channels);
+	uint8_t * raw = malloc(rawLength + 1);
+	uint8_t * pixels = malloc(width * height * channels + 1);
+
+	if (!ended || !headed || !inflateZlib(raw, rawLength, idat, idatLength) ||
+	    !unfilterRows(pixels, raw, width, height, channels)) {
+		free(pixels);
+		pixels = NULL;
+	}
+
+	free(idat);
+	free(raw);
+	return pixels;
+}
+
+// Pixels with long runs and repeats to match, noise that doesn't, and a
+// diagonal ramp, which Paeth predicts exactly and where its ties matter.
+static void fillPixels (uint8_t * pixels, size_t length, size_t rowSize, size_t channels, int pattern) {
+	for (size_t i = 0; i < length; i++) {
+		size_t x = i % rowSize / channels, y = i / rowSize;
+
+		switch (pattern) {
+		case 0: pixels[i] = (uint8_t) (i / 64 * 5 + (i % 9 == 0 ? rand() % 3 : 0)); break;
+		case 1: pixels[i] = rand(); break;
+		case 2: pixels[i] = (i / 300) % 2 ? 0 : rand() % 4 * 60; break;
+		default: pixels[i] = (uint8_t) ((x + y) * 7 + i % channels * 40); break;
+		}
+	}
+}
+
+static void testPNG (uint32_t width, uint32_t height, size_t channels, BG3DVariant variant, int pattern, int level) {
+	static const uint8_t fromARGB[4] = { 1, 2, 3, 0 };
+
+	size_t numPixels = (size_t) width * height;
+	uint8_t * source = malloc(numPixels * channels);
+	BG3DTexture texture = {
+		.header = { .width = width, .height = height, .bufferSize = numPixels * channels },
+		.pixels = source
+	};
+	uint8_t * png;
+	size_t length;
+
+	fillPixels(source, numPixels * channels, (size_t) width * channels, channels, pattern);
+
+	BG3DError error = encodePNG(&texture, variant, level, &png, &length);
+
+	CHECK(error == BG3D_OK, "%ux%u at %zu bytes, level %d: error %d", width, height, channels, level, error);
+
+	if (error != BG3D_OK) {
+		free(source);
+		return;
+	}
+
+	uint8_t * pixels = decodePNG(png, length, width, height, channels);
+	uint8_t * expected = malloc(numPixels * channels);
+
+	// the book's pixels are ARGB, which PNG doesn't have
+	if (channels == 4 && variant == BG3D_VARIANT_BOOK) {
+		for (size_t i = 0; i < numPixels; i++) {
+			for (int k = 0; k < 4; k++) {
+				expected[i * 4 + k] = source[i * 4 + fromARGB[k]];
+			}
+		}
+	} else {
+		memcpy(expected, source, numPixels * channels);
+	}
+
+	CHECK(pixels != NULL, "%ux%u at %zu bytes, pattern %d, level %d: doesn't decode", width, height, channels, pattern, level);
+	CHECK(pixels == NULL || memcmp(pixels, expected, numPixels * channels) == 0,
+	      "%ux%u at %zu bytes, pattern %d, level %d: pixels differ", width, height, channels, pattern, level);
+
+	free(source);
+	free(expected);
+	free(pixels);
+	free(png);
+}
+
+// Stored, the default, and the deepest search, over every pixel size and
+// sizes that split into several stored and compressed blocks.
+static void testPNGs (void) {
+	static const int levels[] = { 0, 1, 6, 9 };
+	static const uint32_t sizes[][2] = { { 1, 1 }, { 5, 3 }, { 17, 9 }, { 64, 64 }, { 300, 200 } };
+
+	srand(3);
+
+	for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+			for (size_t channels = 1; channels <= 4; channels++) {
+				for (int pattern = 0; pattern < 4; pattern++) {
+					testPNG(sizes[s][0], sizes[s][1], channels, BG3D_VARIANT_OTTOMATIC, pattern, levels[l]);
+				}
+			}
+
+			testPNG(sizes[s][0], sizes[s][1], 4, BG3D_VARIANT_BOOK, 0, levels[l]);
+		}
+	}
+}
+
+// Every length up to a few hundred, so the fast kernel's tail takes every
+// length short of 16, from unaligned starts, and carried on from one call
+// to the next.
+static void testCrc (void) {
+	uint8_t data[4096];
+
+	srand(4);
+
+	for (size_t i = 0; i < sizeof(data); i++) {
+		data[i] = rand();
+	}
+
+	pthread_once(&crc32Once, selectCrc32);
+
+	uint32_t (*kernels[2]) (uint32_t, const uint8_t *, size_t) = { crc32Scalar, NULL };
+	const char * names[2] = { "table", "pclmul" };
+
+#ifdef PNG_X86
+	if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+		kernels[1] = crc32PCLMUL;
+	} else {
+		printf("pngTest: no PCLMUL here, so only the table CRC is checked\n");
+	}
+#endif // PNG_X86
+
+	for (int k = 0; k < 2 && kernels[k] != NULL; k++) {
+		for (size_t offset = 0; offset < 4; offset++) {
+			for (size_t length = 0; length < 400; length++) {
+				uint32_t crc = ~kernels[k](~0u, data + offset, length);
+				CHECK(crc == bitwiseCrc(0, data + offset, length), "%s CRC of %zu bytes at %zu", names[k], length, offset);
+			}
+		}
+
+		static const size_t lengths[] = { 1000, 1021, 4000, 4093 };
+
+		for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+			uint32_t whole = bitwiseCrc(0, data + 1, lengths[i]);
+			uint32_t first = ~kernels[k](~0u, data + 1, 77);
+			uint32_t both = ~kernels[k](~first, data + 78, lengths[i] - 77);
+
+			CHECK(both == whole, "%s CRC of %zu bytes in two calls", names[k], lengths[i]);
+		}
+	}
+
+	CHECK(crc32(0, data, 999) == bitwiseCrc(0, data, 999), "selected CRC kernel");
+}
+
+int main (void) {
+	testCrc();
+	testPNGs();
+
+	return failures != 0;
+}